@@ -0,0 +1,437 @@
+#pragma once
+#ifndef LCV_CORE_ALLOCATOR_HPP
+#define LCV_CORE_ALLOCATOR_HPP
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "lcvdef.hpp"
+
+
+namespace lcv
+{
+    /* ///////////////////////////////////////
+    *  //    MatrixAllocator
+    */ //
+    class MatrixAllocator
+    {
+    public:
+        virtual ~MatrixAllocator() = default;
+
+    public:
+        // Returned buffer must be aligned to `LCV_MALLOC_ALIGN` bytes
+        virtual void* allocate(size_t size) = 0;
+
+        // `size` is same as the value passed to `allocate`
+        virtual void deallocate(void* ptr, size_t size) = 0;
+
+        // Allocator which deallocates blocks of this one and is kept alive by them, so blocks can outlive this allocator
+        // `nullptr` means blocks are returned to this allocator, which must outlive them
+        virtual std::shared_ptr<MatrixAllocator> deallocator()
+        {
+            return nullptr;
+        }
+
+    public:
+        static MatrixAllocator* getDefault();
+        static void setDefault(MatrixAllocator* allocator);
+    }; // class MatrixAllocator
+
+    class StdMatrixAllocator : public MatrixAllocator
+    {
+    public:
+        void* allocate(size_t size) final
+        {
+            return fastMalloc(size);
+        }
+
+        void deallocate(void* ptr, size_t /*size*/) final
+        {
+            fastFree(ptr);
+        }
+
+    public:
+        static StdMatrixAllocator* instance()
+        {
+            static StdMatrixAllocator sma;
+            return &sma;
+        }
+    }; // class StdMatrixAllocator
+
+    inline std::atomic<MatrixAllocator*>& default_matrix_allocator()
+    {
+        static std::atomic<MatrixAllocator*> allocator(StdMatrixAllocator::instance());
+        return allocator;
+    } // default_matrix_allocator
+
+    inline MatrixAllocator* MatrixAllocator::getDefault()
+    {
+        return default_matrix_allocator().load(std::memory_order_acquire);
+    }
+
+    inline void MatrixAllocator::setDefault(MatrixAllocator* allocator)
+    {
+        // `nullptr` restores the standard allocator
+        default_matrix_allocator().store(allocator != nullptr ? allocator : StdMatrixAllocator::instance(), std::memory_order_release);
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    PoolMatrixAllocator
+    */ //
+    struct MatrixAllocatorStats
+    {
+        uint64 allocations;     // A number of `allocate` calls
+        uint64 hits;            // Served by a recycled buffer
+        uint64 misses;          // Served by system allocator
+        uint64 deallocations;   // A number of `deallocate` calls
+        size_t bytes_retained;  // Bytes kept in the pool for reuse
+        size_t bytes_in_use;    // Bytes handed out and not returned yet
+
+        double hit_rate() const
+        {
+            return allocations != 0 ? (double)hits / allocations : 0.;
+        }
+    }; // struct MatrixAllocatorStats
+
+    class PoolMatrixAllocator : public MatrixAllocator, Noncopyable
+    {
+    private:
+        // Size classes are 64 bytes and four classes per power of two above it
+        const static int NUM_BUCKETS = 4 * (48 - 6) + 1;
+        const static size_t MIN_BLOCK = 64;
+
+        static int bucket_index(size_t size)
+        {
+            if (size <= MIN_BLOCK)
+                return 0;
+
+            int lp = 0;
+            for (size_t v = size - 1; v > 1; v >>= 1)
+                ++lp;
+
+            const size_t step = ((size_t)1 << lp) / 4;
+            const int sub = (int)((size + step - 1) / step) - 5;
+            return 4 * (lp - 6) + sub + 1;
+        }
+
+        static size_t bucket_size(int index)
+        {
+            if (index == 0)
+                return MIN_BLOCK;
+
+            const int k = index - 1;
+            const int lp = k / 4 + 6;
+            return (size_t)(5 + k % 4) * (((size_t)1 << lp) / 4);
+        }
+
+        struct FreeLists
+        {
+            std::mutex lock;
+            std::vector<void*> blocks[NUM_BUCKETS];
+            size_t bytes = 0;
+
+            void release_all()
+            {
+                for (int i = 0; i < NUM_BUCKETS; ++i)
+                {
+                    for (void* p : blocks[i])
+                        fastFree(p);
+                    blocks[i].clear();
+                }
+                bytes = 0;
+            }
+        }; // struct FreeLists
+
+        struct State;
+
+        struct ThreadCache : FreeLists
+        {
+            std::shared_ptr<State> state;
+
+            ~ThreadCache()
+            {
+                // Hand buffers of exited thread over to shared lists
+                // Nobody else refers this cache anymore
+                state->absorb(*this);
+            }
+        }; // struct ThreadCache
+
+        struct ThreadCaches
+        {
+            std::vector<std::shared_ptr<ThreadCache>> caches;
+            bool* destroyed;
+
+            ~ThreadCaches()
+            {
+                *destroyed = true;
+            }
+        }; // struct ThreadCaches
+
+        struct State : FreeLists, MatrixAllocator, std::enable_shared_from_this<State>
+        {
+            // Blocks keep the state alive, so they are returned here even after the pool is destroyed
+            std::vector<std::weak_ptr<ThreadCache>> caches;
+            std::atomic<bool> alive{ true };
+
+            size_t capacity;
+            size_t thread_capacity;
+            size_t max_blocks_per_bucket;
+
+            std::atomic<uint64> allocations{ 0 };
+            std::atomic<uint64> hits{ 0 };
+            std::atomic<uint64> misses{ 0 };
+            std::atomic<uint64> deallocations{ 0 };
+            std::atomic<size_t> bytes_retained{ 0 };
+            std::atomic<size_t> bytes_in_use{ 0 };
+
+            void absorb(FreeLists& cache)
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                for (int i = 0; i < NUM_BUCKETS; ++i)
+                {
+                    for (void* p : cache.blocks[i])
+                    {
+                        if (alive && bytes + bucket_size(i) <= capacity)
+                        {
+                            blocks[i].push_back(p);
+                            bytes += bucket_size(i);
+                        }
+                        else
+                        {
+                            fastFree(p);
+                            bytes_retained -= bucket_size(i);
+                        }
+                    }
+                    cache.blocks[i].clear();
+                }
+                cache.bytes = 0;
+            }
+
+            ThreadCache* thread_cache()
+            {
+                // A thread keeps one cache per pool which outlives neither of them
+                // Buffers released after the thread's caches are gone (e.g. by static matrices) skip the cache
+                thread_local bool destroyed = false;
+                thread_local ThreadCaches tcs = { {}, &destroyed };
+                if (destroyed)
+                    return nullptr;
+
+                for (auto& c : tcs.caches)
+                {
+                    if (c->state.get() == this)
+                        return c.get();
+                }
+
+                auto cache = std::make_shared<ThreadCache>();
+                cache->state = shared_from_this();
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    caches.push_back(cache);
+                }
+                tcs.caches.push_back(cache);
+                return cache.get();
+            }
+
+            void* allocate(size_t size) final
+            {
+                const int index = bucket_index(size);
+                const size_t block_size = bucket_size(index);
+                void* p = NULL;
+
+                ++allocations;
+
+                // Thread cache first
+                ThreadCache* cache = thread_cache();
+                if (cache != nullptr)
+                {
+                    std::lock_guard<std::mutex> guard(cache->lock);
+                    if (!cache->blocks[index].empty())
+                    {
+                        p = cache->blocks[index].back();
+                        cache->blocks[index].pop_back();
+                        cache->bytes -= block_size;
+                    }
+                }
+
+                // Shared lists second
+                if (p == NULL)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (!blocks[index].empty())
+                    {
+                        p = blocks[index].back();
+                        blocks[index].pop_back();
+                        bytes -= block_size;
+                    }
+                }
+
+                if (p != NULL)
+                {
+                    ++hits;
+                    bytes_retained -= block_size;
+                }
+                else
+                {
+                    // Allocate a whole size class to be reusable by similar requests
+                    ++misses;
+                    if ((p = fastMalloc(block_size)) == NULL)
+                        return NULL;
+                }
+
+                bytes_in_use += block_size;
+                return p;
+            }
+
+            void deallocate(void* ptr, size_t size) final
+            {
+                if (ptr == NULL)
+                    return;
+
+                const int index = bucket_index(size);
+                const size_t block_size = bucket_size(index);
+
+                ++deallocations;
+                bytes_in_use -= block_size;
+
+                // Blocks returned after the pool is destroyed are not kept
+                if (!alive)
+                {
+                    fastFree(ptr);
+                    return;
+                }
+
+                // Keep in thread cache while it has room
+                ThreadCache* cache = thread_cache();
+                if (cache != nullptr)
+                {
+                    std::lock_guard<std::mutex> guard(cache->lock);
+                    if (cache->blocks[index].size() < max_blocks_per_bucket && cache->bytes + block_size <= thread_capacity)
+                    {
+                        cache->blocks[index].push_back(ptr);
+                        cache->bytes += block_size;
+                        bytes_retained += block_size;
+                        return;
+                    }
+                }
+
+                // Move to shared lists while pool has room
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (bytes + block_size <= capacity)
+                    {
+                        blocks[index].push_back(ptr);
+                        bytes += block_size;
+                        bytes_retained += block_size;
+                        return;
+                    }
+                }
+
+                fastFree(ptr);
+            }
+        }; // struct State
+
+
+        std::shared_ptr<State> state;
+
+    public:
+        explicit PoolMatrixAllocator(size_t capacity = (size_t)256 << 20, size_t thread_capacity = (size_t)32 << 20, size_t max_blocks_per_bucket = 4)
+            : state(std::make_shared<State>())
+        {
+            state->capacity = capacity;
+            state->thread_capacity = thread_capacity;
+            state->max_blocks_per_bucket = max_blocks_per_bucket;
+        }
+
+        ~PoolMatrixAllocator()
+        {
+            // Buffers still held by matrices keep the state and are freed when released
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                state->alive = false;
+            }
+            trim();
+        }
+
+    public:
+        void* allocate(size_t size) final
+        {
+            return state->allocate(size);
+        }
+
+        void deallocate(void* ptr, size_t size) final
+        {
+            state->deallocate(ptr, size);
+        }
+
+        std::shared_ptr<MatrixAllocator> deallocator() final
+        {
+            return state;
+        }
+
+    public:
+        MatrixAllocatorStats stats() const
+        {
+            MatrixAllocatorStats s;
+            s.allocations = state->allocations;
+            s.hits = state->hits;
+            s.misses = state->misses;
+            s.deallocations = state->deallocations;
+            s.bytes_retained = state->bytes_retained;
+            s.bytes_in_use = state->bytes_in_use;
+            return s;
+        }
+
+        void resetStats()
+        {
+            state->allocations = 0;
+            state->hits = 0;
+            state->misses = 0;
+            state->deallocations = 0;
+        }
+
+        void trim()
+        {
+            // Release all retained buffers to system
+            // Caches are collected first because the last reference of a cache can flush it into shared lists
+            std::vector<std::shared_ptr<ThreadCache>> caches;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                for (auto& weak : state->caches)
+                {
+                    auto cache = weak.lock();
+                    if (cache)
+                        caches.push_back(cache);
+                }
+
+                // Forget caches of exited threads
+                state->caches.erase(std::remove_if(state->caches.begin(), state->caches.end(),
+                    [](const std::weak_ptr<ThreadCache>& weak) { return weak.expired(); }), state->caches.end());
+            }
+
+            for (auto& cache : caches)
+            {
+                std::lock_guard<std::mutex> guard(cache->lock);
+                state->bytes_retained -= cache->bytes;
+                cache->release_all();
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                state->bytes_retained -= state->bytes;
+                state->release_all();
+            }
+        }
+
+    public:
+        static PoolMatrixAllocator* instance()
+        {
+            // Never destroyed to outlive matrices and threads at exit
+            static PoolMatrixAllocator* pma = new PoolMatrixAllocator();
+            return pma;
+        }
+    }; // class PoolMatrixAllocator
+} // namespace lcv
+#endif // LCV_CORE_ALLOCATOR_HPP
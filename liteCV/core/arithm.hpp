@@ -0,0 +1,476 @@
+#pragma once
+#ifndef LCV_CORE_ARITHM_HPP
+#define LCV_CORE_ARITHM_HPP
+#include <type_traits>
+#include <algorithm>
+
+#include "lcvdef.hpp"
+#include "saturate.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+
+namespace lcv
+{
+    /* ///////////////////////////////////////
+    *  //    Terms of expression
+    */ //
+    // A term makes `Row<T, WT>` evaluating an element of scanline `y` in working type `WT`
+    // Whole expression is evaluated once per element and saturated only when it is stored
+
+    struct MatrixTerm
+    {
+        const Matrix* m;
+
+        template<typename T, typename WT>
+        struct Row
+        {
+            const T* p;
+
+            WT operator()(int i) const
+            {
+                return (WT)p[i];
+            }
+        }; // struct Row
+
+        template<typename T, typename WT>
+        Row<T, WT> row(int y) const
+        {
+            return Row<T, WT>{ m->ptr<T>(y) };
+        }
+
+        const Matrix* leaf() const
+        {
+            return m;
+        }
+
+        bool compatible(const Matrix& ref) const
+        {
+            // Elements are interleaved, planes of PLANAR matrix are evaluated one by one
+            return m->cols == ref.cols && m->rows == ref.rows && m->type() == ref.type() && !m->isPlanar();
+        }
+
+        bool conflicts(const Matrix& dst) const
+        {
+            // Element-wise evaluation can write over itself but not over other pixels of operand
+            return m->overlaps(dst) && !m->isSameView(dst);
+        }
+
+        bool continuous() const
+        {
+            return m->isContinuous();
+        }
+    }; // struct MatrixTerm
+
+    struct ScalarTerm
+    {
+        double v;
+
+        template<typename T, typename WT>
+        struct Row
+        {
+            WT v;
+
+            WT operator()(int /*i*/) const
+            {
+                return v;
+            }
+        }; // struct Row
+
+        template<typename T, typename WT>
+        Row<T, WT> row(int /*y*/) const
+        {
+            return Row<T, WT>{ (WT)v };
+        }
+
+        const Matrix* leaf() const
+        {
+            return nullptr;
+        }
+
+        bool compatible(const Matrix& /*ref*/) const
+        {
+            return true;
+        }
+
+        bool conflicts(const Matrix& /*dst*/) const
+        {
+            return false;
+        }
+
+        bool continuous() const
+        {
+            return true;
+        }
+    }; // struct ScalarTerm
+
+    template<typename Op, typename L, typename R>
+    struct BinaryTerm
+    {
+        L l;
+        R r;
+
+        template<typename T, typename WT>
+        struct Row
+        {
+            typename L::template Row<T, WT> l;
+            typename R::template Row<T, WT> r;
+
+            WT operator()(int i) const
+            {
+                return Op::apply(l(i), r(i));
+            }
+        }; // struct Row
+
+        template<typename T, typename WT>
+        Row<T, WT> row(int y) const
+        {
+            return Row<T, WT>{ l.template row<T, WT>(y), r.template row<T, WT>(y) };
+        }
+
+        const Matrix* leaf() const
+        {
+            return l.leaf() != nullptr ? l.leaf() : r.leaf();
+        }
+
+        bool compatible(const Matrix& ref) const
+        {
+            return l.compatible(ref) && r.compatible(ref);
+        }
+
+        bool conflicts(const Matrix& dst) const
+        {
+            return l.conflicts(dst) || r.conflicts(dst);
+        }
+
+        bool continuous() const
+        {
+            return l.continuous() && r.continuous();
+        }
+    }; // struct BinaryTerm
+
+    struct AddOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return a + b; }
+    }; // struct AddOp
+
+    struct SubOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return a - b; }
+    }; // struct SubOp
+
+    struct MulOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return a * b; }
+    }; // struct MulOp
+
+    struct DivOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return a / b; }
+    }; // struct DivOp
+
+    struct AbsDiffOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return a > b ? a - b : b - a; }
+    }; // struct AbsDiffOp
+
+    struct MinOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return b < a ? b : a; }
+    }; // struct MinOp
+
+    struct MaxOp
+    {
+        template<typename WT>
+        static WT apply(WT a, WT b) { return a < b ? b : a; }
+    }; // struct MaxOp
+
+
+    /* ///////////////////////////////////////
+    *  //    MatrixExpr_
+    */ //
+    template<typename Term>
+    class MatrixExpr_
+    {
+    public:
+        Term term;
+
+    public:
+        explicit MatrixExpr_(const Term& term)
+            : term(term) {}
+
+    private:
+        template<typename T, typename WT>
+        void evaluate(Matrix& dst) const
+        {
+            const int elements = dst.cols * dst.channels();
+
+            // Expression is evaluated into a small block of working type which is saturated at once
+            auto evaluate_row = [&](int y, int begin, int end)
+            {
+                const int BLOCK = 256;
+                WT block[BLOCK];
+
+                const auto src_row = term.template row<T, WT>(y);
+                T* dst_row = dst.ptr<T>(y);
+
+                for (int i = begin; i < end; i += BLOCK)
+                {
+                    const int n = std::min(BLOCK, end - i);
+                    for (int k = 0; k < n; ++k)
+                        block[k] = src_row(i + k);
+                    saturate_cast<T>(block, dst_row + i, n);
+                }
+            };
+
+            // A single pass over scanlines without any intermediate matrix
+            if (term.continuous() && dst.isContinuous() && single_scanline_fits(dst.cols, dst.rows, dst.channels()))
+            {
+                // All pixels are a single long scanline which is split into parallel parts
+                parallel_for_(Range(0, elements * dst.rows), [&](const Range& range)
+                {
+                    evaluate_row(0, range.start, range.end);
+                }, parallel_grain(1));
+                return;
+            }
+
+            parallel_for_(Range(0, dst.rows), [&](const Range& range)
+            {
+                for (int y = range.start; y < range.end; ++y)
+                    evaluate_row(y, 0, elements);
+            }, parallel_grain(elements));
+        }
+
+    public:
+        void assignTo(Matrix& dst) const
+        {
+            // All matrices of expression must have same size and type, result has the type too
+            const Matrix* ref = term.leaf();
+            assert(ref != nullptr && "Expression has no matrix");
+            assert(term.compatible(*ref) && "Matrices of expression must have same size and type");
+
+            // Writing to a matrix of expression is safe because every element is read before it is written
+            // Partially overlapping operands are evaluated into a new buffer
+            if (term.conflicts(dst))
+            {
+                Matrix output;
+                assignTo(output);
+                dst = std::move(output);
+                return;
+            }
+
+            dst.create(ref->cols, ref->rows, ref->type());
+
+            // 8/16-bits integers are exact in float32, others need float64
+            const int depth = ref->depth();
+            if (depth == LCV_8U)
+                evaluate<uchar, float32>(dst);
+            else if (depth == LCV_8S)
+                evaluate<schar, float32>(dst);
+            else if (depth == LCV_16U)
+                evaluate<ushort, float32>(dst);
+            else if (depth == LCV_16S)
+                evaluate<short, float32>(dst);
+            else if (depth == LCV_32U)
+                evaluate<uint, float64>(dst);
+            else if (depth == LCV_32S)
+                evaluate<int, float64>(dst);
+            else if (depth == LCV_32F)
+                evaluate<float32, float32>(dst);
+            else if (depth == LCV_64F)
+                evaluate<float64, float64>(dst);
+            else
+                assert(0 && "Unsupported depth");
+        }
+    }; // class MatrixExpr_
+
+    template<typename Term>
+    Matrix::Matrix(const MatrixExpr_<Term>& expr)
+    {
+        init();
+        expr.assignTo(*this);
+    }
+
+    template<typename Term>
+    Matrix& Matrix::operator=(const MatrixExpr_<Term>& expr)
+    {
+        expr.assignTo(*this);
+        return *this;
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    Operands
+    */ //
+    template<typename T, typename = void>
+    struct ExprOperand
+    {
+        // Not an operand
+        const static bool is_matrix = false;
+        const static bool is_scalar = false;
+    }; // struct ExprOperand
+
+    template<>
+    struct ExprOperand<Matrix>
+    {
+        const static bool is_matrix = true;
+        const static bool is_scalar = false;
+        using Term = MatrixTerm;
+
+        static Term wrap(const Matrix& m)
+        {
+            return Term{ &m };
+        }
+    }; // struct ExprOperand<Matrix>
+
+    template<typename Element>
+    struct ExprOperand<Matrix_<Element>> : ExprOperand<Matrix>
+    {
+        // Typed view is evaluated as Matrix
+    }; // struct ExprOperand<Matrix_>
+
+    template<typename E>
+    struct ExprOperand<MatrixExpr_<E>>
+    {
+        const static bool is_matrix = true;
+        const static bool is_scalar = false;
+        using Term = E;
+
+        static Term wrap(const MatrixExpr_<E>& e)
+        {
+            return e.term;
+        }
+    }; // struct ExprOperand<MatrixExpr_>
+
+    template<typename T>
+    struct ExprOperand<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    {
+        const static bool is_matrix = false;
+        const static bool is_scalar = true;
+        using Term = ScalarTerm;
+
+        static Term wrap(T v)
+        {
+            return Term{ (double)v };
+        }
+    }; // struct ExprOperand<arithmetic>
+
+    template<typename Op, typename L, typename R>
+    using BinaryExpr = MatrixExpr_<BinaryTerm<Op, typename ExprOperand<L>::Term, typename ExprOperand<R>::Term>>;
+
+    // At least one side is a matrix and the other side is a matrix or a scalar
+    template<typename L, typename R>
+    using EnableIfElementwise = typename std::enable_if<
+        (ExprOperand<L>::is_matrix && (ExprOperand<R>::is_matrix || ExprOperand<R>::is_scalar)) ||
+        (ExprOperand<R>::is_matrix && ExprOperand<L>::is_scalar)>::type;
+
+    // One side is a matrix and the other side is a scalar
+    template<typename L, typename R>
+    using EnableIfScaling = typename std::enable_if<
+        (ExprOperand<L>::is_matrix && ExprOperand<R>::is_scalar) ||
+        (ExprOperand<R>::is_matrix && ExprOperand<L>::is_scalar)>::type;
+
+    template<typename Op, typename L, typename R>
+    BinaryExpr<Op, L, R> make_binary_expr(const L& l, const R& r)
+    {
+        using Term = BinaryTerm<Op, typename ExprOperand<L>::Term, typename ExprOperand<R>::Term>;
+        return BinaryExpr<Op, L, R>(Term{ ExprOperand<L>::wrap(l), ExprOperand<R>::wrap(r) });
+    } // make_binary_expr
+
+    template<typename L, typename R, typename = EnableIfElementwise<L, R>>
+    BinaryExpr<AddOp, L, R> operator+(const L& l, const R& r)
+    {
+        return make_binary_expr<AddOp>(l, r);
+    } // operator+
+
+    template<typename L, typename R, typename = EnableIfElementwise<L, R>>
+    BinaryExpr<SubOp, L, R> operator-(const L& l, const R& r)
+    {
+        return make_binary_expr<SubOp>(l, r);
+    } // operator-
+
+    template<typename E, typename = EnableIfElementwise<E, int>>
+    BinaryExpr<SubOp, int, E> operator-(const E& e)
+    {
+        return make_binary_expr<SubOp>(0, e);
+    } // operator-
+
+    template<typename L, typename R, typename = EnableIfScaling<L, R>>
+    BinaryExpr<MulOp, L, R> operator*(const L& l, const R& r)
+    {
+        return make_binary_expr<MulOp>(l, r);
+    } // operator*
+
+    template<typename L, typename R, typename = EnableIfScaling<L, R>>
+    BinaryExpr<DivOp, L, R> operator/(const L& l, const R& r)
+    {
+        return make_binary_expr<DivOp>(l, r);
+    } // operator/
+
+    template<typename L, typename R, typename = EnableIfElementwise<L, R>>
+    BinaryExpr<AbsDiffOp, L, R> absdiff(const L& l, const R& r)
+    {
+        return make_binary_expr<AbsDiffOp>(l, r);
+    } // absdiff
+
+    template<typename L, typename R, typename = EnableIfElementwise<L, R>>
+    BinaryExpr<MinOp, L, R> min(const L& l, const R& r)
+    {
+        return make_binary_expr<MinOp>(l, r);
+    } // min
+
+    template<typename L, typename R, typename = EnableIfElementwise<L, R>>
+    BinaryExpr<MaxOp, L, R> max(const L& l, const R& r)
+    {
+        return make_binary_expr<MaxOp>(l, r);
+    } // max
+
+    template<typename L, typename R, typename = EnableIfElementwise<L, R>>
+    auto addWeighted(const L& src1, double alpha, const R& src2, double beta, double gamma)
+        -> decltype(src1 * alpha + src2 * beta + gamma)
+    {
+        // src1 * alpha + src2 * beta + gamma
+        return src1 * alpha + src2 * beta + gamma;
+    } // addWeighted
+
+
+    /* ///////////////////////////////////////
+    *  //    Functions with destination
+    */ //
+    void add(const Matrix& src1, const Matrix& src2, Matrix& dst)
+    {
+        dst = src1 + src2;
+    } // add
+
+    void subtract(const Matrix& src1, const Matrix& src2, Matrix& dst)
+    {
+        dst = src1 - src2;
+    } // subtract
+
+    void absdiff(const Matrix& src1, const Matrix& src2, Matrix& dst)
+    {
+        dst = absdiff(src1, src2);
+    } // absdiff
+
+    void addWeighted(const Matrix& src1, double alpha, const Matrix& src2, double beta, double gamma, Matrix& dst)
+    {
+        dst = addWeighted(src1, alpha, src2, beta, gamma);
+    } // addWeighted
+
+    void min(const Matrix& src1, const Matrix& src2, Matrix& dst)
+    {
+        dst = min(src1, src2);
+    } // min
+
+    void max(const Matrix& src1, const Matrix& src2, Matrix& dst)
+    {
+        dst = max(src1, src2);
+    } // max
+} // namespace lcv
+#endif // LCV_CORE_ARITHM_HPP
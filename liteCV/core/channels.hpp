@@ -0,0 +1,548 @@
+#pragma once
+#ifndef LCV_CORE_CHANNELS_HPP
+#define LCV_CORE_CHANNELS_HPP
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "lcvdef.hpp"
+#include "lcvtypes.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include "cpu.hpp"
+#include "simd.hpp"
+
+
+namespace lcv
+{
+    /* ///////////////////////////////////////
+    *  //    Channel access
+    */ //
+    template<typename T>
+    T* channel_ptr(const Matrix& m, int y, int x, int channel)
+    {
+        // First element of `channel` at pixel (`x`, `y`), following elements are `channel_stride` apart
+        const size_t offset = m.isPlanar() ? channel * m.step_info.planestep : channel * m.elemSize1();
+        return (T*)(m.ptr(y, x) + offset);
+    } // channel_ptr
+
+    int inline channel_stride(const Matrix& m)
+    {
+        return m.isPlanar() ? 1 : m.channels();
+    } // channel_stride
+
+    template<typename Body>
+    void parallel_for_pixels(const Size& size, int channels, const Body& body)
+    {
+        // `body(y, x, width)` processes `width` pixels of scanline `y` from pixel `x`
+        // Continuous pixels are a single scanline which is split into parallel parts
+        if (size.height == 1)
+        {
+            parallel_for_(Range(0, size.width), [&](const Range& range)
+            {
+                cpu_dispatch([&]() { body(0, range.start, range.size()); });
+            }, parallel_grain(channels));
+        }
+        else
+        {
+            parallel_for_(Range(0, size.height), [&](const Range& range)
+            {
+                cpu_dispatch([&]()
+                {
+                    for (int y = range.start; y < range.end; ++y)
+                        body(y, 0, size.width);
+                });
+            }, parallel_grain((int64)size.width * channels));
+        }
+    } // parallel_for_pixels
+
+    Size inline getContinuousSize(const Matrix* m, size_t count, const Size& size)
+    {
+        // Matrices have `size`, continuous pixels of all are a single scanline
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!m[i].isContinuous() || !single_scanline_fits(size.width, size.height, m[i].channels()))
+                return size;
+        }
+        return Size(size.width * size.height, 1);
+    } // getContinuousSize
+
+
+    /* ///////////////////////////////////////
+    *  //    Channel kernels
+    */ //
+    // Copying does not depend on depth, elements are moved as unsigned integers of same size
+    template<typename T>
+    struct SplitRow
+    {
+        static int simd(const T* /*src*/, T* const* /*dst*/, int /*width*/, int /*cn*/)
+        {
+            return 0;
+        }
+    }; // struct SplitRow
+
+    template<>
+    struct SplitRow<uchar>
+    {
+        static int simd(const uchar* src, uchar* const* dst, int width, int cn)
+        {
+            // Returns pixels processed
+            const int lanes = v_uint8x16::nlanes;
+            int x = 0;
+            if (cn == 2)
+            {
+                for (; x <= width - lanes; x += lanes)
+                {
+                    v_uint8x16 a, b;
+                    v_load_deinterleave(src + x * 2, a, b);
+                    v_store(dst[0] + x, a);
+                    v_store(dst[1] + x, b);
+                }
+            }
+            else if (cn == 3)
+            {
+                for (; x <= width - lanes; x += lanes)
+                {
+                    v_uint8x16 a, b, c;
+                    v_load_deinterleave(src + x * 3, a, b, c);
+                    v_store(dst[0] + x, a);
+                    v_store(dst[1] + x, b);
+                    v_store(dst[2] + x, c);
+                }
+            }
+            else if (cn == 4)
+            {
+                for (; x <= width - lanes; x += lanes)
+                {
+                    v_uint8x16 a, b, c, d;
+                    v_load_deinterleave(src + x * 4, a, b, c, d);
+                    v_store(dst[0] + x, a);
+                    v_store(dst[1] + x, b);
+                    v_store(dst[2] + x, c);
+                    v_store(dst[3] + x, d);
+                }
+            }
+            return x;
+        }
+    }; // struct SplitRow
+
+    template<typename T>
+    struct MergeRow
+    {
+        static int simd(const T* const* /*src*/, T* /*dst*/, int /*width*/, int /*cn*/)
+        {
+            return 0;
+        }
+    }; // struct MergeRow
+
+    template<>
+    struct MergeRow<uchar>
+    {
+        static int simd(const uchar* const* src, uchar* dst, int width, int cn)
+        {
+            // Returns pixels processed
+            const int lanes = v_uint8x16::nlanes;
+            int x = 0;
+            if (cn == 2)
+            {
+                for (; x <= width - lanes; x += lanes)
+                    v_store_interleave(dst + x * 2, v_load(src[0] + x), v_load(src[1] + x));
+            }
+            else if (cn == 3)
+            {
+                for (; x <= width - lanes; x += lanes)
+                    v_store_interleave(dst + x * 3, v_load(src[0] + x), v_load(src[1] + x), v_load(src[2] + x));
+            }
+            else if (cn == 4)
+            {
+                for (; x <= width - lanes; x += lanes)
+                    v_store_interleave(dst + x * 4, v_load(src[0] + x), v_load(src[1] + x), v_load(src[2] + x), v_load(src[3] + x));
+            }
+            return x;
+        }
+    }; // struct MergeRow
+
+    template<typename T>
+    void split_row(const T* src, T* const* dst, int width, int cn)
+    {
+        // Deinterleave `cn` channels of 2 to 4
+        int x = SplitRow<T>::simd(src, dst, simd_width(width), cn);
+        if (cn == 2)
+        {
+            for (; x < width; ++x)
+            {
+                dst[0][x] = src[x * 2];
+                dst[1][x] = src[x * 2 + 1];
+            }
+        }
+        else if (cn == 3)
+        {
+            for (; x < width; ++x)
+            {
+                dst[0][x] = src[x * 3];
+                dst[1][x] = src[x * 3 + 1];
+                dst[2][x] = src[x * 3 + 2];
+            }
+        }
+        else
+        {
+            for (; x < width; ++x)
+            {
+                dst[0][x] = src[x * 4];
+                dst[1][x] = src[x * 4 + 1];
+                dst[2][x] = src[x * 4 + 2];
+                dst[3][x] = src[x * 4 + 3];
+            }
+        }
+    } // split_row
+
+    template<typename T>
+    void merge_row(const T* const* src, T* dst, int width, int cn)
+    {
+        // Interleave `cn` channels of 2 to 4
+        int x = MergeRow<T>::simd(src, dst, simd_width(width), cn);
+        if (cn == 2)
+        {
+            for (; x < width; ++x)
+            {
+                dst[x * 2] = src[0][x];
+                dst[x * 2 + 1] = src[1][x];
+            }
+        }
+        else if (cn == 3)
+        {
+            for (; x < width; ++x)
+            {
+                dst[x * 3] = src[0][x];
+                dst[x * 3 + 1] = src[1][x];
+                dst[x * 3 + 2] = src[2][x];
+            }
+        }
+        else
+        {
+            for (; x < width; ++x)
+            {
+                dst[x * 4] = src[0][x];
+                dst[x * 4 + 1] = src[1][x];
+                dst[x * 4 + 2] = src[2][x];
+                dst[x * 4 + 3] = src[3][x];
+            }
+        }
+    } // merge_row
+
+    template<typename T>
+    void copy_channel_row(const T* src, int src_stride, T* dst, int dst_stride, int width)
+    {
+        // `src` is NULL for zeros
+        if (src == NULL)
+        {
+            for (int x = 0; x < width; ++x)
+                dst[x * dst_stride] = 0;
+        }
+        else if (src_stride == 1 && dst_stride == 1)
+        {
+            memcpy(dst, src, width * sizeof(T));
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x)
+                dst[x * dst_stride] = src[x * src_stride];
+        }
+    } // copy_channel_row
+
+    template<typename T>
+    void split_matrix(const Matrix& src, Matrix* dst)
+    {
+        const int cn = src.channels();
+        std::vector<Matrix> matrices(dst, dst + cn);
+        matrices.push_back(src);
+        const Size size = getContinuousSize(matrices.data(), matrices.size(), Size(src.cols, src.rows));
+
+        parallel_for_pixels(size, cn, [&](int y, int x, int width)
+        {
+            T* planes[4];
+            for (int c = 0; c < cn; ++c)
+                planes[c] = (T*)dst[c].ptr(y, x);
+            split_row<T>((const T*)src.ptr(y, x), planes, width, cn);
+        });
+    } // split_matrix
+
+    template<typename T>
+    void merge_matrix(const Matrix* src, Matrix& dst)
+    {
+        const int cn = dst.channels();
+        std::vector<Matrix> matrices(src, src + cn);
+        matrices.push_back(dst);
+        const Size size = getContinuousSize(matrices.data(), matrices.size(), Size(dst.cols, dst.rows));
+
+        parallel_for_pixels(size, cn, [&](int y, int x, int width)
+        {
+            const T* planes[4];
+            for (int c = 0; c < cn; ++c)
+                planes[c] = (const T*)src[c].ptr(y, x);
+            merge_row<T>(planes, (T*)dst.ptr(y, x), width, cn);
+        });
+    } // merge_matrix
+
+    struct ChannelPair
+    {
+        const Matrix* src; // NULL for zeros
+        int src_channel;
+        Matrix* dst;
+        int dst_channel;
+    }; // struct ChannelPair
+
+    template<typename T>
+    void mix_matrix(const std::vector<ChannelPair>& pairs, const Size& size)
+    {
+        parallel_for_pixels(size, (int)pairs.size(), [&](int y, int x, int width)
+        {
+            for (const ChannelPair& pair : pairs)
+            {
+                const T* src = pair.src != NULL ? channel_ptr<const T>(*pair.src, y, x, pair.src_channel) : NULL;
+                const int src_stride = pair.src != NULL ? channel_stride(*pair.src) : 0;
+                copy_channel_row<T>(src, src_stride, channel_ptr<T>(*pair.dst, y, x, pair.dst_channel), channel_stride(*pair.dst), width);
+            }
+        });
+    } // mix_matrix
+
+
+    /* ///////////////////////////////////////
+    *  //    mixChannels
+    */ //
+    void mixChannels(const Matrix* src, size_t nsrcs, Matrix* dst, size_t ndsts, const int* fromTo, size_t npairs)
+    {
+        // Copy channel `fromTo[i * 2]` to channel `fromTo[i * 2 + 1]`, channels are numbered through all matrices in order
+        // Negative source channel fills zeros, `dst` must be created with same size and depth as `src`
+        // Both interleaved and PLANAR matrices are accepted
+        assert(nsrcs > 0 && ndsts > 0 && fromTo != NULL);
+
+        // Find matrix and its channel of an index
+        auto locate = [](const Matrix* m, size_t count, int index, int& channel) -> const Matrix*
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (index < m[i].channels())
+                {
+                    channel = index;
+                    return &m[i];
+                }
+                index -= m[i].channels();
+            }
+            assert(0 && "Channel index is out of range");
+            return NULL;
+        };
+
+        const Size size(src[0].cols, src[0].rows);
+        const size_t esz1 = src[0].elemSize1();
+        std::vector<ChannelPair> pairs(npairs);
+        std::vector<Matrix> matrices;
+        for (size_t i = 0; i < npairs; ++i)
+        {
+            ChannelPair& pair = pairs[i];
+            pair.src = NULL;
+            pair.src_channel = 0;
+            if (fromTo[i * 2] >= 0)
+                pair.src = locate(src, nsrcs, fromTo[i * 2], pair.src_channel);
+            pair.dst = (Matrix*)locate(dst, ndsts, fromTo[i * 2 + 1], pair.dst_channel);
+
+            assert(pair.dst->cols == size.width && pair.dst->rows == size.height && pair.dst->elemSize1() == esz1);
+            assert(pair.src == NULL || (pair.src->cols == size.width && pair.src->rows == size.height && pair.src->depth() == src[0].depth()));
+            if (pair.src != NULL)
+                matrices.push_back(*pair.src);
+            matrices.push_back(*pair.dst);
+        }
+
+        // Continuous planes are walked like a single scanline too
+        const Size flat = getContinuousSize(matrices.data(), matrices.size(), size);
+        if (esz1 == 1)
+            mix_matrix<uchar>(pairs, flat);
+        else if (esz1 == 2)
+            mix_matrix<ushort>(pairs, flat);
+        else if (esz1 == 4)
+            mix_matrix<uint>(pairs, flat);
+        else
+            mix_matrix<uint64>(pairs, flat);
+    } // mixChannels
+
+    void mixChannels(const std::vector<Matrix>& src, std::vector<Matrix>& dst, const std::vector<int>& fromTo)
+    {
+        mixChannels(src.data(), src.size(), dst.data(), dst.size(), fromTo.data(), fromTo.size() / 2);
+    } // mixChannels
+
+
+    /* ///////////////////////////////////////
+    *  //    split
+    */ //
+    void split(const Matrix& src, Matrix* mv)
+    {
+        // `mv` has `src.channels()` matrices, each gets a single channel of source
+        const int cn = src.channels();
+        MatrixType mt(src.depth());
+        mt.packed.fields.channels = 1;
+        for (int c = 0; c < cn; ++c)
+            mv[c] = reuse_or_create(mv[c], src, src.cols, src.rows, mt.packed.value);
+
+        if (cn == 1 || src.isPlanar())
+        {
+            // Planes are already separated
+            for (int c = 0; c < cn; ++c)
+            {
+                if (src.isPlanar())
+                    src.plane(c).copyTo(mv[c]);
+                else
+                    src.copyTo(mv[c]);
+            }
+            return;
+        }
+
+        if (cn > 4)
+        {
+            std::vector<int> fromTo(cn * 2);
+            for (int c = 0; c < cn; ++c)
+                fromTo[c * 2] = fromTo[c * 2 + 1] = c;
+            mixChannels(&src, 1, mv, cn, fromTo.data(), cn);
+            return;
+        }
+
+        const size_t esz1 = src.elemSize1();
+        if (esz1 == 1)
+            split_matrix<uchar>(src, mv);
+        else if (esz1 == 2)
+            split_matrix<ushort>(src, mv);
+        else if (esz1 == 4)
+            split_matrix<uint>(src, mv);
+        else
+            split_matrix<uint64>(src, mv);
+    } // split
+
+    void split(const Matrix& src, std::vector<Matrix>& mv)
+    {
+        mv.resize(src.channels());
+        split(src, mv.data());
+    } // split
+
+
+    /* ///////////////////////////////////////
+    *  //    merge
+    */ //
+    void merge(const Matrix* mv, size_t count, Matrix& dst)
+    {
+        // Matrices of same size and depth are interleaved into `dst`, channels of each are kept in order
+        assert(mv != NULL && count > 0);
+
+        int cn = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            assert(mv[i].cols == mv[0].cols && mv[i].rows == mv[0].rows && mv[i].depth() == mv[0].depth());
+            cn += mv[i].channels();
+        }
+
+        // Sources are read while `dst` is written, a new buffer is used when they share memory
+        bool reusable = true;
+        for (size_t i = 0; i < count; ++i)
+            reusable = reusable && !mv[i].overlaps(dst);
+
+        MatrixType mt(mv[0].depth());
+        mt.packed.fields.channels = cn;
+        Matrix output = reusable ? dst : Matrix();
+        output.create(mv[0].cols, mv[0].rows, mt.packed.value);
+
+        bool single = cn <= 4;
+        for (size_t i = 0; i < count; ++i)
+            single = single && mv[i].channels() == 1;
+
+        if (cn == 1)
+        {
+            mv[0].copyTo(output);
+        }
+        else if (!single)
+        {
+            std::vector<int> fromTo(cn * 2);
+            for (int c = 0; c < cn; ++c)
+                fromTo[c * 2] = fromTo[c * 2 + 1] = c;
+            mixChannels(mv, count, &output, 1, fromTo.data(), cn);
+        }
+        else
+        {
+            const size_t esz1 = output.elemSize1();
+            if (esz1 == 1)
+                merge_matrix<uchar>(mv, output);
+            else if (esz1 == 2)
+                merge_matrix<ushort>(mv, output);
+            else if (esz1 == 4)
+                merge_matrix<uint>(mv, output);
+            else
+                merge_matrix<uint64>(mv, output);
+        }
+
+        dst = std::move(output);
+    } // merge
+
+    void merge(const std::vector<Matrix>& mv, Matrix& dst)
+    {
+        merge(mv.data(), mv.size(), dst);
+    } // merge
+
+
+    /* ///////////////////////////////////////
+    *  //    extractChannel
+    */ //
+    void extractChannel(const Matrix& src, Matrix& dst, int coi)
+    {
+        assert(coi >= 0 && coi < src.channels());
+        if (src.isPlanar())
+        {
+            src.plane(coi).copyTo(dst);
+            return;
+        }
+
+        MatrixType mt(src.depth());
+        mt.packed.fields.channels = 1;
+        Matrix output = reuse_or_create(dst, src, src.cols, src.rows, mt.packed.value);
+
+        const int fromTo[2] = { coi, 0 };
+        mixChannels(&src, 1, &output, 1, fromTo, 1);
+        dst = std::move(output);
+    } // extractChannel
+
+
+    /* ///////////////////////////////////////
+    *  //    Planar layout conversion
+    */ //
+    void toPlanar(const Matrix& src, Matrix& dst)
+    {
+        // Interleaved channels of `src` are split into planes of PLANAR `dst`
+        if (src.isPlanar())
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        Matrix output = src.overlaps(dst) ? Matrix() : dst;
+        output.createPlanar(src.cols, src.rows, src.type());
+
+        std::vector<Matrix> planes(src.channels());
+        for (int c = 0; c < src.channels(); ++c)
+            planes[c] = output.plane(c);
+        split(src, planes.data());
+
+        dst = std::move(output);
+    } // toPlanar
+
+    void toInterleaved(const Matrix& src, Matrix& dst)
+    {
+        // Planes of PLANAR `src` are merged into interleaved `dst`
+        if (!src.isPlanar())
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        std::vector<Matrix> planes(src.channels());
+        for (int c = 0; c < src.channels(); ++c)
+            planes[c] = src.plane(c);
+        merge(planes, dst);
+    } // toInterleaved
+} // namespace lcv
+#endif // LCV_CORE_CHANNELS_HPP
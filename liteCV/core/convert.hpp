@@ -0,0 +1,210 @@
+#pragma once
+#ifndef LCV_CORE_CONVERT_HPP
+#define LCV_CORE_CONVERT_HPP
+#include <type_traits>
+
+#include "lcvdef.hpp"
+#include "saturate.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+
+namespace lcv
+{
+    /* ///////////////////////////////////////
+    *  //    Scanline converters
+    */ //
+    template<typename ST, typename DT, typename WT>
+    struct ConvertScale
+    {
+        // Generic path for all depth pairs
+        static void run(const ST* src, DT* dst, int n, WT alpha, WT beta)
+        {
+            for (int i = 0; i < n; ++i)
+                dst[i] = saturate_cast<DT>(src[i] * alpha + beta);
+        }
+    }; // struct ConvertScale
+
+#ifdef LCV_SSE2
+    template<>
+    struct ConvertScale<uchar, float32, float32>
+    {
+        static void run(const uchar* src, float32* dst, int n, float32 alpha, float32 beta)
+        {
+            // 16 pixels per iteration, widened to 16 then 32-bits integers before converting to float
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 va = _mm_set1_ps(alpha), vb = _mm_set1_ps(beta);
+
+            const int vector_n = simd_width(n);
+            int i = 0;
+            for (; i <= vector_n - 16; i += 16)
+            {
+                const __m128i v8 = _mm_loadu_si128((const __m128i*)(src + i));
+                const __m128i lo16 = _mm_unpacklo_epi8(v8, zero);
+                const __m128i hi16 = _mm_unpackhi_epi8(v8, zero);
+
+                _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo16, zero)), va), vb));
+                _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo16, zero)), va), vb));
+                _mm_storeu_ps(dst + i + 8, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi16, zero)), va), vb));
+                _mm_storeu_ps(dst + i + 12, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi16, zero)), va), vb));
+            }
+
+            for (; i < n; ++i)
+                dst[i] = src[i] * alpha + beta;
+        }
+    }; // struct ConvertScale<uchar, float32>
+
+    template<>
+    struct ConvertScale<float32, uchar, float32>
+    {
+        static void run(const float32* src, uchar* dst, int n, float32 alpha, float32 beta)
+        {
+            // Rounded half to even by `cvtps` and saturated by signed then unsigned packs
+            const __m128 va = _mm_set1_ps(alpha), vb = _mm_set1_ps(beta);
+
+            const int vector_n = simd_width(n);
+            int i = 0;
+            for (; i <= vector_n - 16; i += 16)
+            {
+                const __m128i v0 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), va), vb));
+                const __m128i v1 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), va), vb));
+                const __m128i v2 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 8), va), vb));
+                const __m128i v3 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 12), va), vb));
+
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+            }
+
+            for (; i < n; ++i)
+                dst[i] = saturate_cast<uchar>(src[i] * alpha + beta);
+        }
+    }; // struct ConvertScale<float32, uchar>
+
+    template<>
+    struct ConvertScale<float32, float32, float32>
+    {
+        static void run(const float32* src, float32* dst, int n, float32 alpha, float32 beta)
+        {
+            const __m128 va = _mm_set1_ps(alpha), vb = _mm_set1_ps(beta);
+
+            const int vector_n = simd_width(n);
+            int i = 0;
+            for (; i <= vector_n - 4; i += 4)
+                _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), va), vb));
+
+            for (; i < n; ++i)
+                dst[i] = src[i] * alpha + beta;
+        }
+    }; // struct ConvertScale<float32, float32>
+#endif // LCV_SSE2
+
+    template<typename ST, typename DT>
+    struct Convert
+    {
+        // Without scaling, integers are converted exactly
+        static void run(const ST* src, DT* dst, int n)
+        {
+            saturate_cast<DT>(src, dst, n);
+        }
+    }; // struct Convert
+
+
+    /* ///////////////////////////////////////
+    *  //    convertTo
+    */ //
+    template<typename ST, typename DT>
+    void convert_matrix(const Matrix& src, Matrix& dst, double alpha, double beta)
+    {
+        // 8/16-bits integers and float32 are exact in float32, others need float64
+        using WT = typename std::conditional<
+            (sizeof(ST) <= 2 || std::is_same<ST, float32>::value) && (sizeof(DT) <= 2 || std::is_same<DT, float32>::value),
+            float32, float64>::type;
+
+        const int cn = src.channels();
+        const bool scaled = alpha != 1 || beta != 0;
+
+        parallel_for_scanlines(src, dst, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
+        {
+            if (scaled)
+                ConvertScale<ST, DT, WT>::run((const ST*)src_scanline, (DT*)dst_scanline, width * cn, (WT)alpha, (WT)beta);
+            else
+                Convert<ST, DT>::run((const ST*)src_scanline, (DT*)dst_scanline, width * cn);
+        });
+    } // convert_matrix
+
+    template<typename ST>
+    void convert_matrix(const Matrix& src, Matrix& dst, int ddepth, double alpha, double beta)
+    {
+        if (ddepth == LCV_8U)
+            convert_matrix<ST, uchar>(src, dst, alpha, beta);
+        else if (ddepth == LCV_8S)
+            convert_matrix<ST, schar>(src, dst, alpha, beta);
+        else if (ddepth == LCV_16U)
+            convert_matrix<ST, ushort>(src, dst, alpha, beta);
+        else if (ddepth == LCV_16S)
+            convert_matrix<ST, short>(src, dst, alpha, beta);
+        else if (ddepth == LCV_32U)
+            convert_matrix<ST, uint>(src, dst, alpha, beta);
+        else if (ddepth == LCV_32S)
+            convert_matrix<ST, int>(src, dst, alpha, beta);
+        else if (ddepth == LCV_32F)
+            convert_matrix<ST, float32>(src, dst, alpha, beta);
+        else if (ddepth == LCV_64F)
+            convert_matrix<ST, float64>(src, dst, alpha, beta);
+        else
+            assert(0 && "Unsupported depth");
+    } // convert_matrix
+
+    inline void Matrix::convertTo(Matrix& dst, int rtype, double alpha, double beta) const
+    {
+        const int sdepth = depth();
+        const int ddepth = rtype < 0 ? sdepth : MatrixType(rtype).depth();
+
+        if (ddepth == sdepth && alpha == 1 && beta == 0)
+        {
+            copyTo(dst);
+            return;
+        }
+
+        // Channels are kept, converting over itself is fine for same depth
+        MatrixType mt(ddepth);
+        mt.packed.fields.channels = channels();
+        if (isPlanar())
+        {
+            // Planes are converted as single channel matrices into planar destination
+            Matrix output = overlaps(dst) && !isSameView(dst) ? Matrix() : dst;
+            output.createPlanar(cols, rows, mt.packed.value);
+            for (int c = 0; c < channels(); ++c)
+            {
+                Matrix output_plane = output.plane(c);
+                plane(c).convertTo(output_plane, ddepth, alpha, beta);
+            }
+
+            dst = std::move(output);
+            return;
+        }
+
+        Matrix output = reuse_or_create(dst, *this, cols, rows, mt.packed.value, true);
+
+        if (sdepth == LCV_8U)
+            convert_matrix<uchar>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_8S)
+            convert_matrix<schar>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_16U)
+            convert_matrix<ushort>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_16S)
+            convert_matrix<short>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_32U)
+            convert_matrix<uint>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_32S)
+            convert_matrix<int>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_32F)
+            convert_matrix<float32>(*this, output, ddepth, alpha, beta);
+        else if (sdepth == LCV_64F)
+            convert_matrix<float64>(*this, output, ddepth, alpha, beta);
+        else
+            assert(0 && "Unsupported depth");
+
+        dst = std::move(output);
+    }
+} // namespace lcv
+#endif // LCV_CORE_CONVERT_HPP
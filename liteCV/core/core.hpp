@@ -4,6 +4,16 @@
 #include "lcvdef.hpp"
 #include "lcvmath.hpp"
 #include "lcvtypes.hpp"
+#include "cpu.hpp"
 #include "saturate.hpp"
+#include "simd.hpp"
+#include "allocator.hpp"
+#include "filemap.hpp"
+#include "parallel.hpp"
 #include "matrix.hpp"
+#include "arithm.hpp"
+#include "convert.hpp"
+#include "reduce.hpp"
+#include "channels.hpp"
+#include "tensor.hpp"
 #endif // LCV_CORE_HPP
@@ -0,0 +1,207 @@
+#pragma once
+#ifndef LCV_CORE_CPU_HPP
+#define LCV_CORE_CPU_HPP
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "lcvdef.hpp"
+
+#ifdef LCV_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif // _MSC_VER
+#endif // LCV_X86
+
+
+namespace lcv
+{
+    enum CpuLevels
+    {
+        CPU_LEVEL_SCALAR,   // No explicit vector kernels, see `simd_width`
+        CPU_LEVEL_SSE2,     // SSE2 on x86, NEON on AArch64
+        CPU_LEVEL_AVX2,     // AVX2 and FMA
+        CPU_LEVEL_AVX512,   // AVX-512 F and BW
+    }; // enum CpuLevels
+
+    /* ///////////////////////////////////////
+    *  //    CpuFeatures
+    */ //
+    struct CpuFeatures
+    {
+        bool sse2 = false;
+        bool sse41 = false;
+        bool avx = false;
+        bool avx2 = false;
+        bool fma = false;
+        bool avx512f = false;
+        bool avx512bw = false;
+        bool neon = false;
+
+    private:
+#ifdef LCV_X86
+        static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+        {
+#ifdef _MSC_VER
+            __cpuidex((int*)regs, leaf, subleaf);
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif // _MSC_VER
+        }
+
+        static uint64 xgetbv()
+        {
+            // Register states saved by OS
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            unsigned int eax, edx;
+            __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return ((uint64)edx << 32) | eax;
+#endif // _MSC_VER
+        }
+#endif // LCV_X86
+
+        CpuFeatures()
+        {
+#if defined(LCV_X86)
+            unsigned int regs[4] = { 0, 0, 0, 0 };
+            cpuid(0, 0, regs);
+            const unsigned int max_leaf = regs[0];
+
+            cpuid(1, 0, regs);
+            sse2 = (regs[3] & (1u << 26)) != 0;
+            sse41 = (regs[2] & (1u << 19)) != 0;
+            fma = (regs[2] & (1u << 12)) != 0;
+
+            // AVX needs OS support of YMM and AVX-512 needs opmask and ZMM too
+            const bool osxsave = (regs[2] & (1u << 27)) != 0;
+            const uint64 xcr0 = osxsave ? xgetbv() : 0;
+            const bool ymm = (xcr0 & 0x06) == 0x06;
+            const bool zmm = (xcr0 & 0xE6) == 0xE6;
+            avx = (regs[2] & (1u << 28)) != 0 && ymm;
+
+            if (max_leaf >= 7)
+            {
+                cpuid(7, 0, regs);
+                avx2 = avx && (regs[1] & (1u << 5)) != 0;
+                avx512f = zmm && (regs[1] & (1u << 16)) != 0;
+                avx512bw = zmm && (regs[1] & (1u << 30)) != 0;
+            }
+#elif defined(LCV_NEON)
+            neon = true;
+#endif // LCV_X86
+        }
+
+    public:
+        int level() const
+        {
+            // The best level supported by this CPU
+            if (avx512f && avx512bw && avx2 && fma)
+                return CPU_LEVEL_AVX512;
+            if (avx2 && fma)
+                return CPU_LEVEL_AVX2;
+            if (sse2 || neon)
+                return CPU_LEVEL_SSE2;
+            return CPU_LEVEL_SCALAR;
+        }
+
+        static const CpuFeatures& instance()
+        {
+            static CpuFeatures features;
+            return features;
+        }
+    }; // struct CpuFeatures
+
+
+    /* ///////////////////////////////////////
+    *  //    CPU level
+    */ //
+    int inline parse_cpu_level(const char* name)
+    {
+        // Level named by LCV_CPU_LEVEL environment variable, `-1` when unknown
+        if (name == NULL)
+            return -1;
+        if (strcmp(name, "scalar") == 0)
+            return CPU_LEVEL_SCALAR;
+        if (strcmp(name, "sse2") == 0 || strcmp(name, "neon") == 0)
+            return CPU_LEVEL_SSE2;
+        if (strcmp(name, "avx2") == 0)
+            return CPU_LEVEL_AVX2;
+        if (strcmp(name, "avx512") == 0)
+            return CPU_LEVEL_AVX512;
+        return -1;
+    } // parse_cpu_level
+
+    inline std::atomic<int>& cpu_level()
+    {
+        // Detected once, LCV_CPU_LEVEL can only lower it
+        static std::atomic<int> level([]()
+        {
+            const int detected = CpuFeatures::instance().level();
+            const int forced = parse_cpu_level(std::getenv("LCV_CPU_LEVEL"));
+            return forced >= 0 && forced < detected ? forced : detected;
+        }());
+        return level;
+    } // cpu_level
+
+    int inline getCpuLevel()
+    {
+        return cpu_level().load(std::memory_order_relaxed);
+    } // getCpuLevel
+
+    void inline setCpuLevel(int level)
+    {
+        // Levels above the detected one are clamped, e.g. for benchmarking each level in a process
+        const int detected = CpuFeatures::instance().level();
+        cpu_level().store(level < detected ? std::max(level, (int)CPU_LEVEL_SCALAR) : detected, std::memory_order_relaxed);
+    } // setCpuLevel
+
+    int inline simd_width(int width)
+    {
+        // Elements of a row handed to vector loops of kernels, none at CPU_LEVEL_SCALAR
+        return getCpuLevel() >= CPU_LEVEL_SSE2 ? width : 0;
+    } // simd_width
+
+
+    /* ///////////////////////////////////////
+    *  //    cpu_dispatch
+    */ //
+    // `body` is inlined into a copy compiled for each level, so plain loops are vectorized by compiler for the selected level
+#ifdef LCV_X86
+    template<typename Body>
+    LCV_TARGET("avx2,fma") LCV_FLATTEN void cpu_run_avx2(const Body& body)
+    {
+        body();
+    } // cpu_run_avx2
+
+    template<typename Body>
+    LCV_TARGET("avx512f,avx512bw,avx2,fma") LCV_FLATTEN void cpu_run_avx512(const Body& body)
+    {
+        body();
+    } // cpu_run_avx512
+#endif // LCV_X86
+
+    template<typename Body>
+    void inline cpu_dispatch(const Body& body)
+    {
+#ifdef LCV_X86
+        const int level = getCpuLevel();
+        if (level >= CPU_LEVEL_AVX512)
+        {
+            cpu_run_avx512(body);
+            return;
+        }
+        if (level >= CPU_LEVEL_AVX2)
+        {
+            cpu_run_avx2(body);
+            return;
+        }
+#endif // LCV_X86
+        body();
+    } // cpu_dispatch
+} // namespace lcv
+#endif // LCV_CORE_CPU_HPP
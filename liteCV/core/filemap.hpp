@@ -0,0 +1,98 @@
+#pragma once
+#ifndef LCV_CORE_FILEMAP_HPP
+#define LCV_CORE_FILEMAP_HPP
+#include <string>
+
+#ifdef _WIN32
+#ifndef _WINDOWS_
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif // _WINDOWS_
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+#include "lcvdef.hpp"
+
+
+namespace lcv
+{
+    class FileMapping
+    {
+    private:
+        FileMapping() = delete;
+
+    public:
+        // Map whole file into memory, returns `NULL` when failed
+        // Pages are loaded by OS when they are touched first
+        static uchar* map(const std::string& filename, bool writable, size_t& size)
+        {
+#ifdef _WIN32
+            HANDLE file = ::CreateFileA(filename.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE)
+                return NULL;
+
+            LARGE_INTEGER file_size;
+            if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+            {
+                ::CloseHandle(file);
+                return NULL;
+            }
+
+            HANDLE mapping = ::CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+            ::CloseHandle(file);
+            if (mapping == NULL)
+                return NULL;
+
+            // The view keeps the mapping object alive
+            void* addr = ::MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+            ::CloseHandle(mapping);
+            if (addr == NULL)
+                return NULL;
+
+            size = (size_t)file_size.QuadPart;
+            return (uchar*)addr;
+#else
+            int fd = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+            if (fd < 0)
+                return NULL;
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                ::close(fd);
+                return NULL;
+            }
+
+            // The mapping keeps the file alive
+            void* addr = ::mmap(NULL, (size_t)st.st_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED)
+                return NULL;
+
+            size = (size_t)st.st_size;
+            return (uchar*)addr;
+#endif // _WIN32
+        }
+
+        static void unmap(uchar* addr, size_t size)
+        {
+            if (addr == NULL)
+                return;
+
+#ifdef _WIN32
+            ::UnmapViewOfFile(addr);
+#else
+            ::munmap(addr, size);
+#endif // _WIN32
+        }
+    }; // class FileMapping
+} // namespace lcv
+#endif // LCV_CORE_FILEMAP_HPP
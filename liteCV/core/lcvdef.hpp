@@ -2,6 +2,7 @@
 #ifndef LCV_CORE_LCVDEF_HPP
 #define LCV_CORE_LCVDEF_HPP
 #include <cstdint>
+#include <cstdlib>
 #include <cassert>
 
 
@@ -9,11 +10,59 @@
 #ifdef _OPENMP
 #ifdef _MSC_VER
 #define LCV_OMP_LOOP_FOR __pragma(omp parallel for) 
+#define LCV_OMP_LOOP_FOR_DYNAMIC __pragma(omp parallel for schedule(dynamic))
 #else
 #define LCV_OMP_LOOP_FOR _Pragma("omp parallel for")
+#define LCV_OMP_LOOP_FOR_DYNAMIC _Pragma("omp parallel for schedule(dynamic)")
 #endif
 #else
 #define LCV_OMP_LOOP_FOR
+#define LCV_OMP_LOOP_FOR_DYNAMIC
+#endif
+
+
+// Backend of `parallel_for_`
+// Built-in thread pool is used unless LCV_PARALLEL_OPENMP is defined in OpenMP build
+#if defined(LCV_PARALLEL_OPENMP) && !defined(_OPENMP)
+#undef LCV_PARALLEL_OPENMP
+#endif
+
+// Minimum amount of elements processed by a task of `parallel_for_`
+#ifndef LCV_PARALLEL_MIN_ELEMENTS
+#define LCV_PARALLEL_MIN_ELEMENTS 16384
+#endif
+
+
+// SIMD instruction sets enabled by compiler
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LCV_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Wider x86 instruction sets are selected at runtime, see cpu.hpp
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LCV_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LCV_TARGET(isa) __attribute__((target(isa)))
+#define LCV_FLATTEN __attribute__((flatten))
+#else
+#define LCV_TARGET(isa)
+#define LCV_FLATTEN
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define LCV_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+// Alignment of buffers allocated by `fastMalloc` and of padded matrix scanlines
+// 64 bytes covers a cache line and the widest vector register (AVX-512)
+#ifndef LCV_MALLOC_ALIGN
+#define LCV_MALLOC_ALIGN 64
 #endif
 
 
@@ -57,4 +106,43 @@ using int64 = int64_t;
 using uint64 = uint64_t;
 using float32 = float;
 using float64 = double;
+
+
+namespace lcv
+{
+    // Memory utilities
+    template<typename T>
+    inline T* alignPtr(T* ptr, int n = (int)sizeof(T))
+    {
+        // `n` must be a power of two
+        return (T*)(((size_t)ptr + n - 1) & -(size_t)n);
+    } // alignPtr
+
+    size_t inline alignSize(size_t size, int n)
+    {
+        // `n` must be a power of two
+        return (size + n - 1) & -(size_t)n;
+    } // alignSize
+
+    inline void* fastMalloc(size_t size)
+    {
+        // Over-allocate and keep the original pointer just before the aligned block
+        uchar* udata = (uchar*)malloc(size + sizeof(void*) + LCV_MALLOC_ALIGN);
+        if (udata == NULL)
+            return NULL;
+
+        uchar** adata = alignPtr((uchar**)udata + 1, LCV_MALLOC_ALIGN);
+        adata[-1] = udata;
+        return adata;
+    } // fastMalloc
+
+    inline void fastFree(void* ptr)
+    {
+        if (ptr != NULL)
+        {
+            uchar* udata = ((uchar**)ptr)[-1];
+            free(udata);
+        }
+    } // fastFree
+} // namespace lcv
 #endif // LCV_CORE_LCVDEF_HPP
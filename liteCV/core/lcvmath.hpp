@@ -1,6 +1,9 @@
 #pragma once
 #ifndef LCV_CORE_LCVMATH_HPP
 #define LCV_CORE_LCVMATH_HPP
+#include <cmath>
+#include <limits>
+
 #include "lcvdef.hpp"
 
 
@@ -12,10 +15,47 @@ namespace lcv
         return (b + (a % b)) % b;
     } // lcvModulo
 
-    template<typename Float>
-    int inline lcvRound(Float v)
+    int inline lcvRound(float64 v)
+    {
+        // Round half to even as the default rounding mode of FPU
+#ifdef LCV_SSE2
+        return _mm_cvtsd_si32(_mm_set_sd(v));
+#else
+        // NaN and out of range results are as vector conversions of the platform, casting them is undefined
+        if (!(v >= (float64)std::numeric_limits<int>::min() && v < (float64)std::numeric_limits<int>::max() + (float64)0.5))
+        {
+#if defined(LCV_X86)
+            return std::numeric_limits<int>::min();
+#else
+            return v != v ? 0 : v > 0 ? std::numeric_limits<int>::max() : std::numeric_limits<int>::min();
+#endif // LCV_X86
+        }
+        return (int)std::lrint(v);
+#endif // LCV_SSE2
+    } // lcvRound
+
+    int inline lcvRound(float32 v)
+    {
+        // Round half to even as the default rounding mode of FPU
+#ifdef LCV_SSE2
+        return _mm_cvtss_si32(_mm_set_ss(v));
+#else
+        // NaN and out of range results are as vector conversions of the platform, casting them is undefined
+        if (!(v >= (float32)std::numeric_limits<int>::min() && v < (float32)std::numeric_limits<int>::max() + (float32)0.5))
+        {
+#if defined(LCV_X86)
+            return std::numeric_limits<int>::min();
+#else
+            return v != v ? 0 : v > 0 ? std::numeric_limits<int>::max() : std::numeric_limits<int>::min();
+#endif // LCV_X86
+        }
+        return (int)std::lrint(v);
+#endif // LCV_SSE2
+    } // lcvRound
+
+    int inline lcvRound(int v)
     {
-        return (int)(v + ((Float)0.5));
+        return v;
     } // lcvRound
 
     template<typename Float>
@@ -1,6 +1,9 @@
 #pragma once
 #ifndef LCV_CORE_TYPES_HPP
 #define LCV_CORE_TYPES_HPP
+#include <cstring>
+#include <cassert>
+#include <cstdint>
 
 
 namespace lcv
@@ -138,6 +141,9 @@ namespace lcv
 	using Vec3d = Vec<float64, 3>;
 	using Vec4d = Vec<float64, 4>;
 
+	// Per channel values such as results of reductions
+	using Scalar = Vec4d;
+
     /* ///////////////////////////////////////
     *  //    Point_, Point3_
     */ //
@@ -338,5 +344,34 @@ namespace lcv
     using Rect2f = Rect_<float32>;
     using Rect2d = Rect_<float64>;
     using Rect = Rect2i;
+
+    /* ///////////////////////////////////////
+    *  //    Range
+    */ //
+    class Range
+    {
+    public:
+        int start, end; // [start, end)
+
+    public:
+        Range() : start(0), end(0) {}
+        Range(int _start, int _end) : start(_start), end(_end) {}
+
+    public:
+        int size() const
+        {
+            return end - start;
+        }
+
+        bool empty() const
+        {
+            return start >= end;
+        }
+
+        static Range all()
+        {
+            return Range(INT32_MIN, INT32_MAX);
+        }
+    }; // class Range
 }; //namespace lcv
 #endif // LCV_CORE_TYPES_HPP
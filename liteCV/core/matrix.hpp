@@ -4,9 +4,22 @@
 #include <string>
 #include <atomic>
 #include <regex>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <new>
+#include <functional>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <limits>
 
 #include "lcvdef.hpp"
 #include "lcvtypes.hpp"
+#include "allocator.hpp"
+#include "filemap.hpp"
+#include "parallel.hpp"
+#include "cpu.hpp"
 
 
 #define LCV_8U      (lcv::ConstMatrixType<8, 0, lcv::MatrixType::UNSIGNED_INTEGER_NUMBER>().constant.packed.value)
@@ -266,19 +279,147 @@ namespace lcv
         MatrixType constant;
 
         constexpr ConstMatrixType()
-            : constant({ Bits, Channels, NType })
+            : constant(Bits, Channels, NType)
         {}
     }; // struct ConstMatrixType
 
+    struct MatrixBuffer
+    {
+        // Placed at the head of each pixel allocation, pixels follow after `header_size()` bytes
+        // A header of external pixels is allocated alone and releases pixels by `deleter`
+        std::atomic<unsigned long> refcount;
+        MatrixAllocator* allocator; // Allocator which deallocates this block
+        std::shared_ptr<MatrixAllocator> owner; // Keeps `allocator` alive if it can outlive the allocator passed to `allocate`
+        size_t size;                // Bytes of the whole block including this header
+        uchar* external;            // External pixels, `NULL` if pixels follow this header
+        bool readonly;              // External pixels cannot be written, e.g. read-only file mapping
+        std::function<void(uchar*)> deleter;
+
+        MatrixBuffer(MatrixAllocator* allocator, const std::shared_ptr<MatrixAllocator>& owner, size_t size)
+            : refcount(1ul), allocator(allocator), owner(owner), size(size), external(NULL), readonly(false) {}
+
+        static size_t header_size()
+        {
+            // Keep pixels aligned as the block itself
+            return alignSize(sizeof(MatrixBuffer), LCV_MALLOC_ALIGN);
+        }
+
+        static MatrixBuffer* allocate(MatrixAllocator* allocator, size_t data_size)
+        {
+            const size_t size = header_size() + data_size;
+            std::shared_ptr<MatrixAllocator> owner = allocator->deallocator();
+            if (owner)
+                allocator = owner.get();
+
+            void* block = allocator->allocate(size);
+            if (block == NULL)
+                throw std::bad_alloc();
+            return new (block) MatrixBuffer(allocator, owner, size);
+        }
+
+        static MatrixBuffer* attach(uchar* external, const std::function<void(uchar*)>& deleter)
+        {
+            MatrixBuffer* buffer = allocate(MatrixAllocator::getDefault(), 0);
+            buffer->external = external;
+            buffer->deleter = deleter;
+            return buffer;
+        }
+
+        static void release(MatrixBuffer* buffer)
+        {
+            if (buffer->deleter)
+                buffer->deleter(buffer->external);
+
+            // `owner` keeps the allocator until the block is returned
+            MatrixAllocator* allocator = buffer->allocator;
+            std::shared_ptr<MatrixAllocator> owner = std::move(buffer->owner);
+            const size_t size = buffer->size;
+            buffer->~MatrixBuffer();
+            allocator->deallocate(buffer, size);
+        }
+
+        uchar* data()
+        {
+            return external != NULL ? external : (uchar*)this + header_size();
+        }
+    }; // struct MatrixBuffer
+
+    template<typename Term>
+    class MatrixExpr_;
+
+    class Tensor;
+
+    struct MatrixRawHeader
+    {
+        // Header of raw matrix file, scanlines start at `offset` and follow by `linestep`
+        char magic[8];      // "LCVRAW" padded by zero
+        uint32_t version;
+        int32_t type;       // Packed MatrixType
+        int32_t cols;
+        int32_t rows;
+        int64_t linestep;
+        int64_t offset;     // Aligned to page size of any platform to be mapped directly
+
+        const static uint32_t VERSION = 1;
+        const static int64_t DATA_OFFSET = 65536;
+
+        static const char* magic_string()
+        {
+            return "LCVRAW";
+        }
+
+        static bool valid_type(int type)
+        {
+            // A packed type of known depth and channels with no other bits
+            MatrixType type_info(type);
+            const int depth = type_info.depth();
+            if (type_info.channels() <= 0)
+                return false;
+
+            MatrixType packed(depth);
+            packed.packed.fields.channels = type_info.channels();
+            return packed.packed.value == type && (depth == LCV_8U || depth == LCV_8S || depth == LCV_16U || depth == LCV_16S
+                || depth == LCV_32U || depth == LCV_32S || depth == LCV_32F || depth == LCV_64F);
+        }
+
+        bool valid(size_t file_size) const
+        {
+            // Header comes from a file, scanlines must fit `linestep` and the file, and `linestep` must fit `int`
+            if (memcmp(magic, magic_string(), strlen(magic_string()) + 1) != 0 || version != VERSION || !valid_type(type))
+                return false;
+
+            const int64_t scanline_bytes = (int64_t)cols * (MatrixType(type).bbp() / 8);
+            return cols > 0 && rows > 0 && linestep >= scanline_bytes && linestep <= std::numeric_limits<int>::max()
+                && offset >= (int64_t)sizeof(MatrixRawHeader) && (uint64_t)offset <= (uint64_t)file_size
+                && (uint64_t)linestep * (uint64_t)rows <= (uint64_t)file_size - (uint64_t)offset;
+        }
+    }; // struct MatrixRawHeader
+
+    bool inline single_scanline_fits(int cols, int rows, int channels)
+    {
+        // Continuous pixels are processed as a single scanline only while its elements are countable by `int`
+        return (int64)cols * rows * channels <= std::numeric_limits<int>::max();
+    } // single_scanline_fits
+
     class Matrix
     {
     public:
+        // Flags of matrix
+        const static int ALIGNED_ROWS = 0x01; // Each scanline starts on `LCV_MALLOC_ALIGN` bytes boundary
+        const static int PLANAR = 0x02; // Each channel is stored in own plane following the previous one, see `plane`
+
+        // Linestep of external data is calculated from cols
+        const static size_t AUTO_STEP = 0;
+
+    public:
+        int flags;
         int cols, rows;
 
         struct
         {
-            int pixelstep;
+            int pixelstep; // Element of a plane for PLANAR matrix
             int linestep;
+            size_t planestep; // Zero unless PLANAR
         } step_info;
 
         MatrixType type_info;
@@ -288,56 +429,64 @@ namespace lcv
         uchar* dataend;
         uchar* datalimit;
 
+        // Allocator for `create`, default allocator is used if it is `nullptr`
+        MatrixAllocator* allocator;
+
     private:
-        std::atomic<unsigned long>* refcount;
+        MatrixBuffer* buffer; // Shared by all matrices referring same pixels
+
+        friend class Tensor; // Images of a batch tensor share its buffer, see tensor.hpp
 
     private:
         void incref()
         {
-            if (refcount == nullptr)
-                refcount = new std::atomic<unsigned long>(0l);
-            ++(*refcount);
+            if (buffer != nullptr)
+                buffer->refcount.fetch_add(1, std::memory_order_relaxed);
         }
 
         void decref()
         {
-            if (refcount != nullptr)
+            if (buffer != nullptr)
             {
-                --(*refcount);
-                if ((*refcount) == 0)
-                {
-                    if (data != NULL)
-                        free(data);
-                    delete refcount;
-                }
+                if (buffer->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    MatrixBuffer::release(buffer);
+                buffer = nullptr;
             }
         }
 
     private:
         void init()
         {
+            flags = 0;
             cols = rows = 0;
             step_info.linestep = step_info.pixelstep = 0;
+            step_info.planestep = 0;
             type_info.packed.value = 0;
             data = datastart = dataend = datalimit = NULL;
-            refcount = nullptr;
+            allocator = nullptr;
+            buffer = nullptr;
         }
 
         void inline deep_copy(const Matrix& another)
         {
-            create(another.cols, another.rows, another.type_info);
+            // Keep the scanline alignment and the layout of source
+            create(another.cols, another.rows, another.type_info, another.flags & (ALIGNED_ROWS | PLANAR));
 
-            if (!another.isSubmatrix())
+            const size_t scanline_bytes = (size_t)cols * step_info.pixelstep;
+            if (isContinuous() && another.isContinuous())
             {
                 // Just copying data fully
-                memcpy(data, another.data, step_info.linestep * rows);
+                memcpy(data, another.data, (size_t)cols * rows * elemSize());
             }
             else
             {
-                // Copying data line by line
-                for (int y = 0;y < another.rows;++y)
+                // Copying data line by line of each plane
+                for (int p = 0; p < planes(); ++p)
                 {
-                    memcpy(ptr(y), another.ptr(y), step_info.linestep);
+                    for (int y = 0;y < another.rows;++y)
+                    {
+                        memcpy(ptr(y) + p * step_info.planestep, another.ptr(y) + p * another.step_info.planestep, scanline_bytes);
+                    }
                 }
             }
         }
@@ -346,11 +495,13 @@ namespace lcv
         {
             if (must_be_released)
                 decref();
+            this->flags = another.flags;
             this->cols = another.cols;
             this->rows = another.rows;
             this->step_info = another.step_info;
             this->type_info = another.type_info;
-            this->refcount = another.refcount;
+            this->allocator = another.allocator;
+            this->buffer = another.buffer;
             this->data = another.data;
             this->datastart = another.datastart;
             this->dataend = another.dataend;
@@ -358,15 +509,35 @@ namespace lcv
             incref();
         }
 
+        void inline swallow_move(Matrix&& another)
+        {
+            // Take over the reference of another without touching the refcount
+            decref();
+            this->flags = another.flags;
+            this->cols = another.cols;
+            this->rows = another.rows;
+            this->step_info = another.step_info;
+            this->type_info = another.type_info;
+            this->allocator = another.allocator;
+            this->buffer = another.buffer;
+            this->data = another.data;
+            this->datastart = another.datastart;
+            this->dataend = another.dataend;
+            this->datalimit = another.datalimit;
+            another.init();
+        }
+
         void inline swallow_copy(const Matrix& another, const Rect& roi, bool must_be_released)
         {
             if (must_be_released)
                 decref();
+            this->flags = another.flags;
             this->cols = roi.width;
             this->rows = roi.height;
             this->step_info = another.step_info;
             this->type_info = another.type_info;
-            this->refcount = another.refcount;
+            this->allocator = another.allocator;
+            this->buffer = another.buffer;
             this->data = (uchar*)another.ptr(roi.y, roi.x);
             this->datastart = another.datastart;
             this->dataend = another.dataend;
@@ -391,6 +562,13 @@ namespace lcv
             swallow_copy(another, false);
         }
 
+        Matrix(Matrix&& another) noexcept
+        {
+            // Moving with initializer
+            init();
+            swallow_move(std::forward<Matrix>(another));
+        }
+
         Matrix(const Matrix& another, const Rect& roi)
         {
             // Copying with ROI with initializer
@@ -421,11 +599,39 @@ namespace lcv
             create(cols, rows, channels, dtype);
         }
 
+        template<typename Term>
+        Matrix(const MatrixExpr_<Term>& expr); // Evaluating expression, see arithm.hpp
+
+        Matrix(int cols, int rows, int type, void* data, size_t linestep = AUTO_STEP)
+        {
+            // Refer external data without copying
+            // The data is not released by matrix and must outlive all matrices referring it
+            init();
+            attach(cols, rows, MatrixType(type), (uchar*)data, linestep, nullptr);
+        }
+
+        Matrix(int cols, int rows, int type, void* data, size_t linestep, const std::function<void(uchar*)>& deleter)
+        {
+            // Refer external data without copying
+            // `deleter` is called with `data` when the last matrix referring it is released
+            init();
+            attach(cols, rows, MatrixType(type), (uchar*)data, linestep, deleter ? MatrixBuffer::attach((uchar*)data, deleter) : nullptr);
+        }
+
     public:
         Matrix& operator=(const Matrix& another)
         {
             // Copying by '=' operator
-            swallow_copy(another, true);
+            if (this != &another)
+                swallow_copy(another, true);
+            return *this;
+        }
+
+        Matrix& operator=(Matrix&& another) noexcept
+        {
+            // Moving by '=' operator
+            if (this != &another)
+                swallow_move(std::forward<Matrix>(another));
             return *this;
         }
 
@@ -437,6 +643,9 @@ namespace lcv
             return sub_matrix;
         }
 
+        template<typename Term>
+        Matrix& operator=(const MatrixExpr_<Term>& expr); // Evaluating expression, see arithm.hpp
+
         template<typename Element>
         Matrix& operator=(const Element& value)
         {
@@ -447,59 +656,126 @@ namespace lcv
 
     private:
         // ONLY USES FOR CREATE MATRIX IN THE CLASS
-        void create(int cols, int rows, const MatrixType& type_info)
+        void create(int cols, int rows, const MatrixType& type_info, int flags = 0)
         {
+            // Keep current pixels when size, type and layout are same, e.g. destination of previous frame
+            // Read-only pixels are never written, a new buffer is used instead
+            if (data != NULL && (buffer == NULL || !buffer->readonly) && this->cols == cols && this->rows == rows && this->type_info.packed.value == type_info.packed.value &&
+                (this->flags & PLANAR) == (flags & PLANAR) && (!(flags & ALIGNED_ROWS) || isAligned()))
+                return;
+
             // Calculate size
-            int pixel_bytes = (int)type_info.bbp() / 8;
+            // Scanlines are padded to `LCV_MALLOC_ALIGN` bytes when ALIGNED_ROWS is requested
+            // Planes of PLANAR matrix are single channel images following each other
+            const int planes = (flags & PLANAR) ? type_info.channels() : 1;
+            int pixel_bytes = (int)type_info.bbp() / 8 / planes;
             int scanline_bytes = cols * pixel_bytes;
+            int linestep = (flags & ALIGNED_ROWS) ? (int)alignSize(scanline_bytes, LCV_MALLOC_ALIGN) : scanline_bytes;
+            const size_t planestep = (flags & PLANAR) ? (size_t)rows * linestep : 0;
 
             // Allocate memory first
-            uchar* datastart;
-            uchar* dataend;
-            if ((datastart = (uchar*)malloc(rows * scanline_bytes)) == NULL)
-                throw std::bad_exception();
-            dataend = datastart + (rows * scanline_bytes);
+            // Header and pixels share one block, the first scanline is aligned as the block
+            MatrixBuffer* buffer = MatrixBuffer::allocate(allocator != nullptr ? allocator : MatrixAllocator::getDefault(), (size_t)rows * linestep * planes);
+            uchar* datastart = buffer->data();
 
             // Update attributes
             decref();
+            this->flags = flags & (ALIGNED_ROWS | PLANAR);
             this->cols = cols;
             this->rows = rows;
             this->step_info.pixelstep = pixel_bytes;
-            this->step_info.linestep = scanline_bytes;
+            this->step_info.linestep = linestep;
+            this->step_info.planestep = planestep;
             this->type_info = type_info;
             this->datastart = datastart;
-            this->dataend = dataend;
-            this->datalimit = datalimit;
+            this->dataend = datastart + (planes - 1) * planestep + (size_t)(rows - 1) * linestep + scanline_bytes;
+            this->datalimit = datastart + (size_t)rows * linestep * planes;
             this->data = datastart;
-            incref();
+            this->buffer = buffer;
+        }
+
+        void attach(int cols, int rows, const MatrixType& type_info, uchar* data, size_t linestep, MatrixBuffer* buffer, size_t planestep = 0)
+        {
+            // Non-zero `planestep` refers planes of PLANAR matrix
+            const int planes = planestep != 0 ? type_info.channels() : 1;
+            int pixel_bytes = (int)type_info.bbp() / 8 / planes;
+            int scanline_bytes = cols * pixel_bytes;
+            if (linestep == AUTO_STEP)
+                linestep = scanline_bytes;
+
+            // Scanlines and planes of external data cannot overlap
+            assert((int)linestep >= scanline_bytes);
+            assert(planes == 1 || planestep >= (size_t)(rows - 1) * linestep + scanline_bytes);
+
+            // Update attributes
+            decref();
+            this->flags = planestep != 0 ? PLANAR : 0;
+            this->cols = cols;
+            this->rows = rows;
+            this->step_info.pixelstep = pixel_bytes;
+            this->step_info.linestep = (int)linestep;
+            this->step_info.planestep = planestep;
+            this->type_info = type_info;
+            this->datastart = data;
+            this->dataend = data + (planes - 1) * planestep + (size_t)(rows - 1) * linestep + scanline_bytes;
+            this->datalimit = this->dataend;
+            this->data = data;
+            this->buffer = buffer;
+        }
+
+        void inline zero_fill()
+        {
+            // Padding bytes of scanlines are also cleared
+            memset(datastart, 0, datalimit - datastart);
         }
 
     public:
         static Matrix zeros(int cols, int rows, int type)
         {
             Matrix m(cols, rows, type);
-            memset(m.ptr(), 0, m.rows * m.step_info.linestep);
+            m.zero_fill();
             return m;
         }
 
         static Matrix zeros(int cols, int rows, const std::string& channel_string)
         {
             Matrix m(cols, rows, channel_string);
-            memset(m.ptr(), 0, m.rows * m.step_info.linestep);
+            m.zero_fill();
             return m;
         }
 
         static Matrix zeros(int cols, int rows, int channels, int type_wo_channels)
         {
             Matrix m(cols, rows, channels, type_wo_channels);
-            memset(m.ptr(), 0, m.rows * m.step_info.linestep);
+            m.zero_fill();
             return m;
         }
 
         static Matrix zeros(int cols, int rows, int channels, const std::string& dtype)
         {
             Matrix m(cols, rows, channels, dtype);
-            memset(m.ptr(), 0, m.rows * m.step_info.linestep);
+            m.zero_fill();
+            return m;
+        }
+
+        static Matrix aligned(int cols, int rows, int type)
+        {
+            Matrix m;
+            m.createAligned(cols, rows, type);
+            return m;
+        }
+
+        static Matrix aligned(int cols, int rows, const std::string& channel_string)
+        {
+            Matrix m;
+            m.createAligned(cols, rows, channel_string);
+            return m;
+        }
+
+        static Matrix planar(int cols, int rows, int type)
+        {
+            Matrix m;
+            m.createPlanar(cols, rows, type);
             return m;
         }
 
@@ -530,24 +806,133 @@ namespace lcv
             create(cols, rows, MatrixType(channels, dtype));
         }
 
+        void createAligned(int cols, int rows, int type)
+        {
+            // Create matrix whose scanlines start on `LCV_MALLOC_ALIGN` bytes boundary
+            create(cols, rows, MatrixType(type), ALIGNED_ROWS);
+        }
+
+        void createAligned(int cols, int rows, const std::string& channel_string)
+        {
+            // Create matrix whose scanlines start on `LCV_MALLOC_ALIGN` bytes boundary
+            create(cols, rows, MatrixType(channel_string), ALIGNED_ROWS);
+        }
+
+        void createPlanar(int cols, int rows, int type, bool aligned = false)
+        {
+            // Create matrix storing channels in separate planes, scanlines of planes are aligned if `aligned`
+            create(cols, rows, MatrixType(type), PLANAR | (aligned ? ALIGNED_ROWS : 0));
+        }
+
+        Matrix plane(int channel) const
+        {
+            // Single channel view of a plane of PLANAR matrix, sharing pixels
+            assert(isPlanar() && channel >= 0 && channel < channels());
+
+            MatrixType mt(depth());
+            mt.packed.fields.channels = 1;
+
+            Matrix m(*this);
+            m.flags &= ~PLANAR;
+            m.type_info = mt;
+            m.step_info.planestep = 0;
+            m.data += channel * step_info.planestep;
+
+            // Parent of the view is same plane of the parent, see `locateROI`
+            m.datastart += channel * step_info.planestep;
+            m.dataend -= (planes() - 1 - channel) * step_info.planestep;
+            return m;
+        }
+
+        void locateROI(Size& wholeSize, Point& ofs) const
+        {
+            // Size of the parent matrix and position of this ROI in it
+            // Planes of PLANAR matrix are located by the first plane
+            assert(!empty() && step_info.linestep > 0);
+
+            const size_t linestep = step_info.linestep;
+            const size_t offset = data - datastart;
+            const size_t extent = (dataend - datastart) - (planes() - 1) * step_info.planestep;
+            ofs.y = (int)(offset / linestep);
+            ofs.x = (int)((offset - ofs.y * linestep) / step_info.pixelstep);
+
+            // The last scanline of the parent ends at `extent`
+            const size_t min_width = (size_t)(ofs.x + cols) * step_info.pixelstep;
+            wholeSize.height = std::max((int)((extent - min_width) / linestep) + 1, ofs.y + rows);
+            wholeSize.width = std::max((int)((extent - (wholeSize.height - 1) * linestep) / step_info.pixelstep), ofs.x + cols);
+        }
+
+        Matrix& adjustROI(int dtop, int dbottom, int dleft, int dright)
+        {
+            // Move sides of ROI outwards by positive deltas and inwards by negative ones, clipped by the parent
+            Size wholeSize;
+            Point ofs;
+            locateROI(wholeSize, ofs);
+
+            const int top = std::max(ofs.y - dtop, 0), bottom = std::min(ofs.y + rows + dbottom, wholeSize.height);
+            const int left = std::max(ofs.x - dleft, 0), right = std::min(ofs.x + cols + dright, wholeSize.width);
+            assert(top < bottom && left < right);
+
+            data += (ptrdiff_t)(top - ofs.y) * step_info.linestep + (ptrdiff_t)(left - ofs.x) * step_info.pixelstep;
+            cols = right - left;
+            rows = bottom - top;
+            return *this;
+        }
+
         template<typename Element>
         void setTo(const Element& value)
         {
             // The size of value and matrix's element size must be same
             assert(sizeof(value) == elemSize());
 
+            if (isPlanar())
+            {
+                // Each plane is filled with its channel of value
+                const size_t channel_bytes = elemSize1();
+                for (int p = 0; p < planes(); ++p)
+                {
+                    const uchar* channel_value = (const uchar*)&value + p * channel_bytes;
+                    for (int y = 0; y < rows; ++y)
+                    {
+                        uchar* scanline = ptr(y) + p * step_info.planestep;
+                        for (int x = 0; x < cols; ++x)
+                            memcpy(scanline + x * channel_bytes, channel_value, channel_bytes);
+                    }
+                }
+                return;
+            }
+
             // Set all elements to single value
-            for (int i = 0; i < cols * rows; ++i)
-                ptr<Element>()[i] = value;
+            // Walk scanlines because they can be padded or be a part of parent, continuous pixels are a single scanline
+            const bool single = isContinuous() && single_scanline_fits(cols, rows, channels());
+            const int width = single ? cols * rows : cols;
+            const int height = single ? 1 : rows;
+            for (int y = 0; y < height; ++y)
+            {
+                Element* scanline = ptr<Element>(y);
+                for (int x = 0; x < width; ++x)
+                    scanline[x] = value;
+            }
         }
 
         void copyTo(Matrix& matrix) const
         {
-            Matrix m;
-            m.deep_copy(*this);
-            matrix = m;
+            // Pixels of `matrix` are reused when it has same size and type
+            if (overlaps(matrix))
+            {
+                Matrix m;
+                m.deep_copy(*this);
+                matrix = std::move(m);
+            }
+            else
+            {
+                matrix.deep_copy(*this);
+            }
         }
 
+        // Convert elements to depth of `rtype` (`-1` keeps depth) as `saturate_cast(src * alpha + beta)`, see convert.hpp
+        void convertTo(Matrix& dst, int rtype, double alpha = 1, double beta = 0) const;
+
         Matrix clone() const
         {
             Matrix m;
@@ -555,6 +940,84 @@ namespace lcv
             return m;
         }
 
+        void swap(Matrix& another) noexcept
+        {
+            // Exchange headers only
+            std::swap(flags, another.flags);
+            std::swap(cols, another.cols);
+            std::swap(rows, another.rows);
+            std::swap(step_info, another.step_info);
+            std::swap(type_info.packed.value, another.type_info.packed.value);
+            std::swap(allocator, another.allocator);
+            std::swap(buffer, another.buffer);
+            std::swap(data, another.data);
+            std::swap(datastart, another.datastart);
+            std::swap(dataend, another.dataend);
+            std::swap(datalimit, another.datalimit);
+        }
+
+        bool saveRaw(const std::string& filename) const
+        {
+            // Save as raw matrix file which can be mapped by `mapFile`
+            // Scanlines keep the padding of ALIGNED_ROWS matrix
+            // Raw files store interleaved channels only
+            if (empty() || isPlanar())
+                return false;
+
+            const size_t scanline_bytes = (size_t)cols * step_info.pixelstep;
+            const size_t linestep = (flags & ALIGNED_ROWS) ? alignSize(scanline_bytes, LCV_MALLOC_ALIGN) : scanline_bytes;
+
+            MatrixRawHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, MatrixRawHeader::magic_string(), strlen(MatrixRawHeader::magic_string()));
+            header.version = MatrixRawHeader::VERSION;
+            header.type = type();
+            header.cols = cols;
+            header.rows = rows;
+            header.linestep = (int64_t)linestep;
+            header.offset = MatrixRawHeader::DATA_OFFSET;
+
+            std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            std::vector<char> padding((size_t)header.offset - sizeof(header), 0);
+            file.write((const char*)&header, sizeof(header));
+            file.write(padding.data(), padding.size());
+
+            padding.assign(linestep - scanline_bytes, 0);
+            for (int y = 0; y < rows && file; ++y)
+            {
+                file.write((const char*)ptr(y), scanline_bytes);
+                file.write(padding.data(), padding.size());
+            }
+
+            return (bool)file.flush();
+        }
+
+        static Matrix mapFile(const std::string& filename, bool writable = false)
+        {
+            // Map pixels of raw matrix file saved by `saveRaw` without reading them
+            // Only touched scanlines are paged in, writes go to the file if `writable`
+            // Pixels of read-only mapping are not reused as output, see `create`
+            size_t size = 0;
+            uchar* addr = FileMapping::map(filename, writable, size);
+            if (addr == NULL)
+                return Matrix();
+
+            const MatrixRawHeader* header = (const MatrixRawHeader*)addr;
+            if (size < sizeof(MatrixRawHeader) || !header->valid(size))
+            {
+                FileMapping::unmap(addr, size);
+                return Matrix();
+            }
+
+            Matrix m(header->cols, header->rows, header->type, addr + header->offset, (size_t)header->linestep,
+                [addr, size](uchar*) { FileMapping::unmap(addr, size); });
+            m.buffer->readonly = !writable;
+            return m;
+        }
+
     public:
         bool empty() const
         {
@@ -563,12 +1026,13 @@ namespace lcv
 
         size_t elemSize() const
         {
-            return (size_t)step_info.pixelstep;
+            // Bytes of all channels of a pixel, also for PLANAR matrix
+            return (size_t)type_info.bbp() / 8;
         }
 
         size_t elemSize1() const
         {
-            return (size_t)step_info.pixelstep / type_info.channels();
+            return elemSize() / type_info.channels();
         }
 
         int width() const
@@ -608,25 +1072,91 @@ namespace lcv
             return data != datastart;
         }
 
+        bool isContinuous() const
+        {
+            // Scanlines follow each other without padding, planes of PLANAR matrix too
+            if (isPlanar())
+                return step_info.planestep == (size_t)cols * rows * step_info.pixelstep &&
+                    (rows == 1 || (size_t)step_info.linestep == (size_t)cols * step_info.pixelstep);
+            return rows == 1 || (size_t)step_info.linestep == (size_t)cols * step_info.pixelstep;
+        }
+
+        bool isPlanar() const
+        {
+            return (flags & PLANAR) != 0;
+        }
+
+        int planes() const
+        {
+            // Planes holding channels, one for interleaved matrix
+            return isPlanar() ? channels() : 1;
+        }
+
+        bool isAligned() const
+        {
+            // Every scanline starts on `LCV_MALLOC_ALIGN` bytes boundary
+            return ((size_t)data % LCV_MALLOC_ALIGN) == 0 && (step_info.linestep % LCV_MALLOC_ALIGN) == 0;
+        }
+
+        bool overlaps(const Matrix& another) const
+        {
+            // Pixels of both matrices share any byte
+            if (data == NULL || another.data == NULL || empty() || another.empty())
+                return false;
+
+            // `dataend` belongs to the parent for ROIs, use the end of own pixels
+            const size_t width = (size_t)cols * step_info.pixelstep;
+            const size_t another_width = (size_t)another.cols * another.step_info.pixelstep;
+            const uchar* end = data + (planes() - 1) * step_info.planestep + (size_t)(rows - 1) * step_info.linestep + width;
+            const uchar* another_end = another.data + (another.planes() - 1) * another.step_info.planestep +
+                (size_t)(another.rows - 1) * another.step_info.linestep + another_width;
+            if (data >= another_end || another.data >= end)
+                return false;
+
+            // ROIs of same parent can interleave their scanlines without sharing pixels
+            if (datastart == another.datastart && step_info.linestep == another.step_info.linestep && step_info.linestep > 0 &&
+                !isPlanar() && !another.isPlanar())
+            {
+                const size_t linestep = step_info.linestep;
+                const size_t offset = data - datastart;
+                const size_t another_offset = another.data - datastart;
+                const size_t x = offset % linestep, y = offset / linestep;
+                const size_t another_x = another_offset % linestep, another_y = another_offset / linestep;
+
+                return x < another_x + another_width && another_x < x + width &&
+                    y < another_y + another.rows && another_y < y + rows;
+            }
+
+            return true;
+        }
+
+        bool isSameView(const Matrix& another) const
+        {
+            // Both headers refer exactly same pixels in same layout
+            return data != NULL && data == another.data && cols == another.cols && rows == another.rows &&
+                step_info.linestep == another.step_info.linestep && step_info.pixelstep == another.step_info.pixelstep &&
+                step_info.planestep == another.step_info.planestep;
+        }
+
     public:
         uchar* ptr(int y=0)
         {
-            return data + (step_info.linestep * y);
+            return data + ((ptrdiff_t)step_info.linestep * y);
         }
 
         const uchar* ptr(int y=0) const
         {
-            return data + (step_info.linestep * y);
+            return data + ((ptrdiff_t)step_info.linestep * y);
         }
 
         uchar* ptr(int y, int x)
         {
-            return data + (step_info.linestep * y) + (step_info.pixelstep * x);
+            return data + ((ptrdiff_t)step_info.linestep * y) + (step_info.pixelstep * x);
         }
 
         const uchar* ptr(int y, int x) const
         {
-            return data + (step_info.linestep * y) + (step_info.pixelstep * x);
+            return data + ((ptrdiff_t)step_info.linestep * y) + (step_info.pixelstep * x);
         }
 
         template<typename Element>
@@ -644,12 +1174,15 @@ namespace lcv
         template<typename Element>
         Element* ptr(int y, int x)
         {
+            // `Element` is a whole pixel, which PLANAR matrix doesn't store in one place
+            assert(!isPlanar());
             return (Element*)ptr(y, x);
         }
 
         template<typename Element>
         const Element* ptr(int y, int x) const
         {
+            assert(!isPlanar());
             return (Element*)ptr(y, x);
         }
 
@@ -691,6 +1224,302 @@ namespace lcv
         }
     }; // class Matrix
 
+    void inline swap(Matrix& a, Matrix& b) noexcept
+    {
+        a.swap(b);
+    } // swap
+
+    Matrix inline reuse_or_create(Matrix& dst, const Matrix& src, int cols, int rows, int type, bool in_place = false)
+    {
+        // Output header of an operation, it refers pixels of `dst` when they have same size and type
+        // A new buffer is used when `dst` shares memory with `src` to not overwrite pixels not read yet,
+        // unless the operation supports `in_place` and `dst` is exactly `src`
+        const bool reusable = !src.overlaps(dst) || (in_place && src.isSameView(dst));
+        Matrix output = reusable ? dst : Matrix();
+        output.create(cols, rows, type);
+        return output;
+    } // reuse_or_create
+
+    Size inline getContinuousSize(const Matrix& m)
+    {
+        // Continuous pixels are a single scanline
+        const bool single = m.isContinuous() && single_scanline_fits(m.cols, m.rows, m.channels());
+        return single ? Size(m.cols * m.rows, 1) : Size(m.cols, m.rows);
+    } // getContinuousSize
+
+    Size inline getContinuousSize(const Matrix& m1, const Matrix& m2)
+    {
+        // Matrices have same size
+        const bool single = m1.isContinuous() && m2.isContinuous() && single_scanline_fits(m1.cols, m1.rows, std::max(m1.channels(), m2.channels()));
+        return single ? Size(m1.cols * m1.rows, 1) : Size(m1.cols, m1.rows);
+    } // getContinuousSize
+
+    template<typename Body>
+    void inline parallel_for_scanlines(const Matrix& src, Matrix& dst, const Body& body)
+    {
+        // `body(src_scanline, dst_scanline, width)` processes `width` pixels of a scanline
+        // Continuous matrices are a single long scanline which is split into parallel parts
+        // `body` is compiled for the CPU level selected at runtime, see `cpu_dispatch`
+        // Pixels are interleaved, PLANAR matrices are processed as planes
+        assert(src.cols == dst.cols && src.rows == dst.rows);
+        assert(!src.isPlanar() && !dst.isPlanar());
+
+        const Size size = getContinuousSize(src, dst);
+        if (size.height == 1)
+        {
+            const uchar* src_data = src.ptr();
+            uchar* dst_data = dst.ptr();
+            const size_t src_pixel = src.elemSize(), dst_pixel = dst.elemSize();
+
+            parallel_for_(Range(0, size.width), [&](const Range& range)
+            {
+                cpu_dispatch([&]() { body(src_data + range.start * src_pixel, dst_data + range.start * dst_pixel, range.size()); });
+            }, parallel_grain(std::max(src.channels(), dst.channels())));
+        }
+        else
+        {
+            parallel_for_(Range(0, size.height), [&](const Range& range)
+            {
+                cpu_dispatch([&]()
+                {
+                    for (int y = range.start; y < range.end; ++y)
+                        body(src.ptr(y), dst.ptr(y), size.width);
+                });
+            }, parallel_grain((int64)size.width * std::max(src.channels(), dst.channels())));
+        }
+    } // parallel_for_scanlines
+
     using Mat = Matrix;
+
+    /* ///////////////////////////////////////
+    *  //    DataType
+    */ //
+    // Matrix type of a pixel type known at compile time
+    template<typename Element>
+    struct DataType;
+
+    template<typename Channel, int Bits, int NType>
+    struct ChannelDataType
+    {
+        using channel_type = Channel;
+        const static int bits = Bits;
+        const static int channels = 1;
+        const static int ntype = NType;
+
+        static int type()
+        {
+            return MatrixType(bits, channels, ntype).packed.value;
+        }
+    }; // struct ChannelDataType
+
+    template<> struct DataType<uchar> : ChannelDataType<uchar, 8, MatrixType::UNSIGNED_INTEGER_NUMBER> {};
+    template<> struct DataType<schar> : ChannelDataType<schar, 8, MatrixType::SIGNED_INTEGER_NUMBER> {};
+    template<> struct DataType<ushort> : ChannelDataType<ushort, 16, MatrixType::UNSIGNED_INTEGER_NUMBER> {};
+    template<> struct DataType<short> : ChannelDataType<short, 16, MatrixType::SIGNED_INTEGER_NUMBER> {};
+    template<> struct DataType<uint> : ChannelDataType<uint, 32, MatrixType::UNSIGNED_INTEGER_NUMBER> {};
+    template<> struct DataType<int> : ChannelDataType<int, 32, MatrixType::SIGNED_INTEGER_NUMBER> {};
+    template<> struct DataType<float32> : ChannelDataType<float32, 32, MatrixType::REAL_NUMBER> {};
+    template<> struct DataType<float64> : ChannelDataType<float64, 64, MatrixType::REAL_NUMBER> {};
+
+    template<typename Type, int N>
+    struct DataType<Element_<Type, N>>
+    {
+        using channel_type = Type;
+        const static int bits = DataType<Type>::bits;
+        const static int channels = N;
+        const static int ntype = DataType<Type>::ntype;
+
+        static int type()
+        {
+            return MatrixType(bits, channels, ntype).packed.value;
+        }
+    }; // struct DataType<Element_>
+
+    /* ///////////////////////////////////////
+    *  //    Matrix_
+    */ //
+    // Typed view of Matrix, pixel size and channels are compile time constants
+    template<typename Element>
+    class Matrix_ : public Matrix
+    {
+    public:
+        using value_type = Element;
+        using channel_type = typename DataType<Element>::channel_type;
+
+        const static int PIXEL_BYTES = (int)sizeof(Element);
+        const static int CHANNELS = DataType<Element>::channels;
+
+        struct Scanline
+        {
+            Element* first;
+            Element* last;
+
+            Element* begin() const { return first; }
+            Element* end() const { return last; }
+        }; // struct Scanline
+
+    private:
+        bool inline is_compatible(const Matrix& m) const
+        {
+            // Pixels are accessed as `Element`, so channels of PLANAR matrix can't be viewed
+            return m.empty() || (m.type() == DataType<Element>::type() && !m.isPlanar());
+        }
+
+    public:
+        Matrix_() = default;
+        Matrix_(const Matrix_& another) = default;
+        Matrix_(Matrix_&& another) noexcept = default;
+
+        Matrix_(int cols, int rows)
+            : Matrix(cols, rows, DataType<Element>::type()) {}
+
+        Matrix_(int cols, int rows, const Element& value)
+            : Matrix(cols, rows, DataType<Element>::type())
+        {
+            setTo(value);
+        }
+
+        Matrix_(int cols, int rows, Element* data, size_t linestep = AUTO_STEP)
+            : Matrix(cols, rows, DataType<Element>::type(), data, linestep) {}
+
+        Matrix_(const Matrix& another)
+            : Matrix(another)
+        {
+            // Type of matrix must be same as `Element`
+            assert(is_compatible(another));
+        }
+
+        Matrix_(Matrix&& another)
+            : Matrix(std::forward<Matrix>(another))
+        {
+            // Type of matrix must be same as `Element`
+            assert(is_compatible(*this));
+        }
+
+        template<typename Term>
+        Matrix_(const MatrixExpr_<Term>& expr)
+            : Matrix(expr)
+        {
+            // Type of expression must be same as `Element`
+            assert(is_compatible(*this));
+        }
+
+    public:
+        Matrix_& operator=(const Matrix_& another) = default;
+        Matrix_& operator=(Matrix_&& another) noexcept = default;
+
+        Matrix_& operator=(const Matrix& another)
+        {
+            assert(is_compatible(another));
+            Matrix::operator=(another);
+            return *this;
+        }
+
+        Matrix_& operator=(Matrix&& another)
+        {
+            assert(is_compatible(another));
+            Matrix::operator=(std::forward<Matrix>(another));
+            return *this;
+        }
+
+        template<typename Term>
+        Matrix_& operator=(const MatrixExpr_<Term>& expr)
+        {
+            Matrix::operator=(expr);
+            assert(is_compatible(*this));
+            return *this;
+        }
+
+        Matrix_& operator=(const Element& value)
+        {
+            setTo(value);
+            return *this;
+        }
+
+    public:
+        void create(int cols, int rows)
+        {
+            Matrix::create(cols, rows, DataType<Element>::type());
+        }
+
+        void createAligned(int cols, int rows)
+        {
+            Matrix::createAligned(cols, rows, DataType<Element>::type());
+        }
+
+        Matrix_ clone() const
+        {
+            return Matrix_(Matrix::clone());
+        }
+
+    public:
+        Element* operator[](int y)
+        {
+            return (Element*)(data + (ptrdiff_t)step_info.linestep * y);
+        }
+
+        const Element* operator[](int y) const
+        {
+            return (const Element*)(data + (ptrdiff_t)step_info.linestep * y);
+        }
+
+        Element& operator()(int y, int x)
+        {
+            return (*this)[y][x];
+        }
+
+        const Element& operator()(int y, int x) const
+        {
+            return (*this)[y][x];
+        }
+
+        Element& operator()(Point pt)
+        {
+            return (*this)[pt.y][pt.x];
+        }
+
+        const Element& operator()(Point pt) const
+        {
+            return (*this)[pt.y][pt.x];
+        }
+
+        Matrix_ operator()(const Rect& roi) const
+        {
+            return Matrix_(Matrix::operator()(roi));
+        }
+
+        Scanline scanline(int y)
+        {
+            Element* first = (*this)[y];
+            return Scanline{ first, first + cols };
+        }
+    }; // class Matrix_
+
+    template<typename Element>
+    using Mat_ = Matrix_<Element>;
+
+    using Matrix1b = Matrix_<uchar>;
+    using Matrix2b = Matrix_<Vec2b>;
+    using Matrix3b = Matrix_<Vec3b>;
+    using Matrix4b = Matrix_<Vec4b>;
+    using Matrix1s = Matrix_<short>;
+    using Matrix1w = Matrix_<ushort>;
+    using Matrix1i = Matrix_<int>;
+    using Matrix1f = Matrix_<float32>;
+    using Matrix3f = Matrix_<Vec3f>;
+    using Matrix1d = Matrix_<float64>;
+    using Matrix3d = Matrix_<Vec3d>;
+
+    using Mat1b = Matrix1b;
+    using Mat2b = Matrix2b;
+    using Mat3b = Matrix3b;
+    using Mat4b = Matrix4b;
+    using Mat1s = Matrix1s;
+    using Mat1w = Matrix1w;
+    using Mat1i = Matrix1i;
+    using Mat1f = Matrix1f;
+    using Mat3f = Matrix3f;
+    using Mat1d = Matrix1d;
+    using Mat3d = Matrix3d;
 } // namespace lcv
 #endif // LCV_CORE_MATRIX_HPP
@@ -0,0 +1,532 @@
+#pragma once
+#ifndef LCV_CORE_PARALLEL_HPP
+#define LCV_CORE_PARALLEL_HPP
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#ifndef _WINDOWS_
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif // _WINDOWS_
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif // _WIN32
+
+#include "lcvdef.hpp"
+#ifdef LCV_PARALLEL_OPENMP
+#include <omp.h>
+#endif // LCV_PARALLEL_OPENMP
+#include "lcvtypes.hpp"
+
+
+namespace lcv
+{
+    using ParallelLoopBody = std::function<void(const Range&)>;
+
+    /* ///////////////////////////////////////
+    *  //    ThreadPool
+    */ //
+    // Persistent workers sharing loops by work stealing
+    // A loop is split into a slice per participant, a participant takes `grain` iterations from the front of its slice
+    // and steals the back half of another slice when its slice is exhausted
+    class ThreadPool : Noncopyable
+    {
+    private:
+        struct Job
+        {
+            const ParallelLoopBody* body;
+            int start;
+            int grain;
+            int participants;
+
+            // Slices are packed [begin, end) offsets from `start`, padded to a cache line each
+            struct Slice
+            {
+                std::atomic<uint64> packed;
+                char padding[64 - sizeof(std::atomic<uint64>)];
+            };
+            std::unique_ptr<Slice[]> slices;
+
+            std::atomic<int> remaining;  // Iterations not processed yet
+            std::atomic<int> attached;   // Workers which can still touch this job
+            std::atomic<bool> failed;
+
+            std::mutex error_lock;
+            std::exception_ptr error;
+        }; // struct Job
+
+        static uint64 pack(uint32_t begin, uint32_t end)
+        {
+            return ((uint64)end << 32) | begin;
+        }
+
+        static uint32_t begin_of(uint64 packed)
+        {
+            return (uint32_t)packed;
+        }
+
+        static uint32_t end_of(uint64 packed)
+        {
+            return (uint32_t)(packed >> 32);
+        }
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::mutex job_lock; // Only one loop runs on the pool at once
+        std::vector<int> cpus; // Worker `i` is pinned to `cpus[i % cpus.size()]`
+        std::atomic<int> num_workers;
+
+        uint64 generation;
+        Job* job;
+        bool stopping;
+
+    private:
+        static bool& in_parallel_region()
+        {
+            thread_local bool flag = false;
+            return flag;
+        }
+
+        static bool take_front(Job::Slice& slice, int grain, uint32_t& begin, uint32_t& end)
+        {
+            uint64 v = slice.packed.load(std::memory_order_acquire);
+            for (;;)
+            {
+                const uint32_t b = begin_of(v), e = end_of(v);
+                if (b >= e)
+                    return false;
+
+                const uint32_t nb = std::min<uint32_t>(b + (uint32_t)grain, e);
+                if (slice.packed.compare_exchange_weak(v, pack(nb, e), std::memory_order_acq_rel))
+                {
+                    begin = b;
+                    end = nb;
+                    return true;
+                }
+            }
+        }
+
+        static bool steal(Job& job, int thief)
+        {
+            // Move back half of a victim's slice into the thief's empty slice
+            for (int k = 1; k < job.participants; ++k)
+            {
+                Job::Slice& victim = job.slices[(thief + k) % job.participants];
+                uint64 v = victim.packed.load(std::memory_order_acquire);
+                for (;;)
+                {
+                    const uint32_t b = begin_of(v), e = end_of(v);
+                    if (b >= e)
+                        break;
+
+                    const uint32_t half = ((e - b) / 2 / (uint32_t)job.grain) * (uint32_t)job.grain;
+                    const uint32_t mid = e - std::max<uint32_t>(half, std::min<uint32_t>((uint32_t)job.grain, e - b));
+                    if (victim.packed.compare_exchange_weak(v, pack(b, mid), std::memory_order_acq_rel))
+                    {
+                        job.slices[thief].packed.store(pack(mid, e), std::memory_order_release);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        static void participate(Job& job, int index)
+        {
+            uint32_t begin, end;
+            for (;;)
+            {
+                if (!take_front(job.slices[index], job.grain, begin, end))
+                {
+                    if (!steal(job, index))
+                        break;
+                    continue;
+                }
+
+                // Skip remaining iterations after a failure but still count them
+                if (!job.failed.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        (*job.body)(Range(job.start + (int)begin, job.start + (int)end));
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> guard(job.error_lock);
+                        if (!job.error)
+                            job.error = std::current_exception();
+                        job.failed = true;
+                    }
+                }
+
+                job.remaining.fetch_sub((int)(end - begin), std::memory_order_acq_rel);
+            }
+        }
+
+        void worker_main(int index)
+        {
+            in_parallel_region() = true;
+
+            uint64 seen = 0;
+            for (;;)
+            {
+                Job* current = nullptr;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    wake.wait(guard, [&]() { return stopping || generation != seen; });
+                    if (stopping)
+                        return;
+
+                    seen = generation;
+
+                    // Participant 0 is the caller
+                    if (job != nullptr && index + 1 < job->participants)
+                        current = job;
+                }
+
+                if (current != nullptr)
+                {
+                    participate(*current, index + 1);
+                    if (current->attached.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        done.notify_all();
+                    }
+                }
+            }
+        }
+
+        static void pin(std::thread& t, int cpu)
+        {
+            // Pinning is a hint, failures are ignored
+#if defined(_WIN32)
+            if (cpu < (int)sizeof(DWORD_PTR) * 8)
+                ::SetThreadAffinityMask(t.native_handle(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+            if (cpu >= CPU_SETSIZE)
+                return;
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            ::pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#endif // _WIN32
+        }
+
+        void start_workers(int count)
+        {
+            stopping = false;
+            for (int i = 0; i < count; ++i)
+            {
+                workers.emplace_back(&ThreadPool::worker_main, this, i);
+                if (!cpus.empty())
+                    pin(workers.back(), cpus[i % cpus.size()]);
+            }
+            num_workers = (int)workers.size();
+        }
+
+        void stop_workers()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for (auto& w : workers)
+                w.join();
+            workers.clear();
+            num_workers = 0;
+        }
+
+    public:
+        explicit ThreadPool(int threads)
+            : num_workers(0), generation(0), job(nullptr), stopping(false)
+        {
+            // The caller of `run` is also a participant
+            start_workers(std::max(threads, 1) - 1);
+        }
+
+        ~ThreadPool()
+        {
+            stop_workers();
+        }
+
+    public:
+        int size() const
+        {
+            return num_workers.load(std::memory_order_relaxed) + 1;
+        }
+
+        static bool inParallelRegion()
+        {
+            return in_parallel_region();
+        }
+
+        void resize(int threads)
+        {
+            // Waits for the running loop
+            assert(!in_parallel_region() && "Pool cannot be resized from a parallel loop");
+            std::lock_guard<std::mutex> job_guard(job_lock);
+
+            threads = std::max(threads, 1);
+            if (threads == size())
+                return;
+
+            stop_workers();
+            start_workers(threads - 1);
+        }
+
+        void setAffinity(const std::vector<int>& cpu_list)
+        {
+            // Workers are restarted to drop previous pinning, the calling thread is never pinned
+            assert(!in_parallel_region() && "Affinity cannot be changed from a parallel loop");
+            std::lock_guard<std::mutex> job_guard(job_lock);
+
+            const int count = (int)workers.size();
+            stop_workers();
+            cpus = cpu_list;
+            start_workers(count);
+        }
+
+        void run(const Range& range, const ParallelLoopBody& body, int grain, int max_threads = 0)
+        {
+            // `max_threads` limits participants including the caller, `0` uses all of them
+            if (range.empty())
+                return;
+            grain = std::max(grain, 1);
+
+            const int chunks = (range.size() + grain - 1) / grain;
+
+            // Run serially in nested loops, tiny loops, single-threaded scopes or while another loop uses the pool
+            std::unique_lock<std::mutex> job_guard(job_lock, std::defer_lock);
+            if (in_parallel_region() || chunks < 2 || max_threads == 1 || !job_guard.try_lock())
+            {
+                body(range);
+                return;
+            }
+
+            const int threads = max_threads > 0 ? std::min(max_threads, size()) : size();
+            if (threads < 2)
+            {
+                body(range);
+                return;
+            }
+
+            Job j;
+            j.body = &body;
+            j.start = range.start;
+            j.grain = grain;
+            j.participants = std::min(chunks, threads);
+            j.slices.reset(new Job::Slice[j.participants]);
+            j.remaining = range.size();
+            j.attached = j.participants - 1;
+            j.failed = false;
+
+            // Contiguous slices in multiples of grain
+            for (int p = 0; p < j.participants; ++p)
+            {
+                const int b = (int)(((int64)chunks * p / j.participants) * grain);
+                const int e = std::min((int)(((int64)chunks * (p + 1) / j.participants) * grain), range.size());
+                j.slices[p].packed.store(pack((uint32_t)b, (uint32_t)e), std::memory_order_relaxed);
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                job = &j;
+                ++generation;
+            }
+            wake.notify_all();
+
+            in_parallel_region() = true;
+            participate(j, 0);
+            in_parallel_region() = false;
+
+            // Wait until all iterations are processed and no worker refers the job
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                done.wait(guard, [&]() { return j.attached.load(std::memory_order_acquire) == 0; });
+                job = nullptr;
+            }
+            assert(j.remaining == 0);
+
+            if (j.error)
+                std::rethrow_exception(j.error);
+        }
+
+    public:
+        static int defaultThreads()
+        {
+            // LCV_NUM_THREADS environment variable overrides number of hardware threads
+            const char* env = std::getenv("LCV_NUM_THREADS");
+            if (env != NULL && std::atoi(env) > 0)
+                return std::atoi(env);
+
+            const int n = (int)std::thread::hardware_concurrency();
+            return n > 0 ? n : 1;
+        }
+
+        static ThreadPool* instance()
+        {
+            // Never destroyed to keep workers valid during static destruction
+            static ThreadPool* tp = new ThreadPool(defaultThreads());
+            return tp;
+        }
+    }; // class ThreadPool
+
+
+    /* ///////////////////////////////////////
+    *  //    Parallel settings
+    */ //
+    struct ParallelSettings
+    {
+        std::atomic<bool> nested{ false };
+
+        static ParallelSettings& instance()
+        {
+            static ParallelSettings ps;
+            return ps;
+        }
+
+        static int& thread_limit()
+        {
+            // Per thread limit set by `ParallelScope`, `0` means no limit
+            thread_local int limit = 0;
+            return limit;
+        }
+    }; // struct ParallelSettings
+
+    void inline setNumThreads(int threads)
+    {
+        // Number of threads of parallel loops including the calling thread
+        // `1` runs every loop serially, `0` or less restores default (LCV_NUM_THREADS or number of hardware threads)
+        if (threads <= 0)
+            threads = ThreadPool::defaultThreads();
+
+#ifdef LCV_PARALLEL_OPENMP
+        omp_set_num_threads(threads);
+#else
+        ThreadPool::instance()->resize(threads);
+#endif // LCV_PARALLEL_OPENMP
+    } // setNumThreads
+
+    int inline getNumThreads()
+    {
+        // Number of threads a parallel loop called from this thread can use
+#ifdef LCV_PARALLEL_OPENMP
+        const int threads = omp_get_max_threads();
+#else
+        const int threads = ThreadPool::instance()->size();
+#endif // LCV_PARALLEL_OPENMP
+        const int limit = ParallelSettings::thread_limit();
+        return limit > 0 ? std::min(limit, threads) : threads;
+    } // getNumThreads
+
+    void inline setThreadAffinity(const std::vector<int>& cpus)
+    {
+        // Pin workers of built-in pool to CPUs in round robin, empty list unpins them
+        // OpenMP backend is controlled by OMP_PROC_BIND and OMP_PLACES instead
+#ifndef LCV_PARALLEL_OPENMP
+        ThreadPool::instance()->setAffinity(cpus);
+#endif // LCV_PARALLEL_OPENMP
+    } // setThreadAffinity
+
+    void inline setNestedParallelism(bool enabled)
+    {
+        // Disabled by default, parallel loops called from a loop body run serially
+        // Built-in pool serves one loop at once, so nested loops stay serial on it anyway
+        ParallelSettings::instance().nested = enabled;
+#ifdef LCV_PARALLEL_OPENMP
+        omp_set_max_active_levels(enabled ? 2 : 1);
+#endif // LCV_PARALLEL_OPENMP
+    } // setNestedParallelism
+
+    bool inline getNestedParallelism()
+    {
+        return ParallelSettings::instance().nested;
+    } // getNestedParallelism
+
+    class ParallelScope : Noncopyable
+    {
+    private:
+        int saved;
+
+    public:
+        explicit ParallelScope(int threads)
+            : saved(ParallelSettings::thread_limit())
+        {
+            // Limit parallel loops called from this thread while the scope lives, `1` keeps them serial
+            ParallelSettings::thread_limit() = std::max(threads, 0);
+        }
+
+        ~ParallelScope()
+        {
+            ParallelSettings::thread_limit() = saved;
+        }
+    }; // class ParallelScope
+
+
+    /* ///////////////////////////////////////
+    *  //    parallel_for_
+    */ //
+    int inline parallel_grain(int64 elements_per_iteration)
+    {
+        // Iterations per task to have at least LCV_PARALLEL_MIN_ELEMENTS elements
+        if (elements_per_iteration <= 0)
+            return 1;
+        return (int)std::max<int64>(1, (LCV_PARALLEL_MIN_ELEMENTS + elements_per_iteration - 1) / elements_per_iteration);
+    } // parallel_grain
+
+    void inline parallel_for_(const Range& range, const ParallelLoopBody& body, int grain = 1)
+    {
+        // `body` is called with disjoint sub ranges of `range`, each has `grain` iterations at least except the last
+        if (range.empty())
+            return;
+
+        const int limit = ParallelSettings::thread_limit();
+
+#ifdef LCV_PARALLEL_OPENMP
+        const bool nested = ParallelSettings::instance().nested.load(std::memory_order_relaxed);
+        grain = std::max(grain, 1);
+        const int chunks = (range.size() + grain - 1) / grain;
+        if (chunks < 2 || limit == 1 || (omp_in_parallel() && !nested))
+        {
+            body(range);
+            return;
+        }
+
+        const int saved = omp_get_max_threads();
+        if (limit > 0)
+            omp_set_num_threads(std::min(limit, saved));
+
+        LCV_OMP_LOOP_FOR_DYNAMIC
+        for (int i = 0; i < chunks; ++i)
+        {
+            const int start = range.start + i * grain;
+            body(Range(start, std::min(start + grain, range.end)));
+        }
+
+        if (limit > 0)
+            omp_set_num_threads(saved);
+#else
+        ThreadPool::instance()->run(range, body, grain, limit);
+#endif // LCV_PARALLEL_OPENMP
+    } // parallel_for_
+} // namespace lcv
+#endif // LCV_CORE_PARALLEL_HPP
@@ -0,0 +1,554 @@
+#pragma once
+#ifndef LCV_CORE_REDUCE_HPP
+#define LCV_CORE_REDUCE_HPP
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+
+#include "lcvdef.hpp"
+#include "lcvtypes.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include "cpu.hpp"
+#include "simd.hpp"
+
+
+namespace lcv
+{
+    enum NormTypes
+    {
+        NORM_INF = 1,
+        NORM_L1 = 2,
+        NORM_L2 = 4
+    }; // enum NormTypes
+
+
+    /* ///////////////////////////////////////
+    *  //    parallel_reduce
+    */ //
+    template<typename Acc, typename Body>
+    Acc parallel_reduce(const Size& size, int channels, const Acc& init, const Body& body)
+    {
+        // `body(acc, y, x, width)` accumulates `width` pixels of scanline `y` from pixel `x` into `acc`
+        // Blocks depend only on the size, so results are same for any number of threads
+        const bool flat = size.height == 1;
+        const int length = flat ? size.width : size.height;
+        const int block = flat ? std::max(1, LCV_PARALLEL_MIN_ELEMENTS / channels) : parallel_grain((int64)size.width * channels);
+        const int blocks = (int)(((int64)length + block - 1) / block);
+
+        std::vector<Acc> partial(std::max(blocks, 1), init);
+        parallel_for_(Range(0, blocks), [&](const Range& range)
+        {
+            cpu_dispatch([&]()
+            {
+                for (int b = range.start; b < range.end; ++b)
+                {
+                    // Accumulate locally, neighbouring partials share cache lines
+                    Acc acc = init;
+                    const int start = b * block;
+                    const int end = (int)std::min<int64>(length, (int64)start + block);
+                    if (flat)
+                        body(acc, 0, start, end - start);
+                    else
+                    {
+                        for (int y = start; y < end; ++y)
+                            body(acc, y, 0, size.width);
+                    }
+                    partial[b] = acc;
+                }
+            });
+        });
+
+        // Merge neighbours pairwise, preceding block first
+        for (int step = 1; step < blocks; step *= 2)
+        {
+            for (int i = 0; i + step < blocks; i += step * 2)
+                partial[i].merge(partial[i + step]);
+        }
+        return partial[0];
+    } // parallel_reduce
+
+    Size inline getContinuousSize(const Matrix& src1, const Matrix& src2, const Matrix& mask)
+    {
+        // Optional `src2` and `mask` have same size as `src1`
+        const bool continuous = src1.isContinuous() && (src2.empty() || src2.isContinuous()) && (mask.empty() || mask.isContinuous())
+            && single_scanline_fits(src1.cols, src1.rows, src1.channels());
+        return continuous ? Size(src1.cols * src1.rows, 1) : Size(src1.cols, src1.rows);
+    } // getContinuousSize
+
+    void inline check_reduce_args(const Matrix& src1, const Matrix& src2, const Matrix& mask)
+    {
+        assert(!src1.isPlanar() && !src2.isPlanar() && !mask.isPlanar());
+        assert(src2.empty() || (src2.cols == src1.cols && src2.rows == src1.rows && src2.type() == src1.type()));
+        assert(mask.empty() || (mask.cols == src1.cols && mask.rows == src1.rows && mask.type() == LCV_8UC1));
+    } // check_reduce_args
+
+
+    /* ///////////////////////////////////////
+    *  //    Sums
+    */ //
+    enum SumStatFlags
+    {
+        STAT_SUM = 1,       // Sums per channel
+        STAT_SQSUM = 2,     // Sums of squares per channel
+        STAT_MAX = 4,       // Maximum of all channels, used with STAT_ABS
+        STAT_ABS = 8,       // Absolute values, differences of two sources are always absolute
+        STAT_NONZERO = 16   // Values are 1 when not zero
+    }; // enum SumStatFlags
+
+    struct SumStats
+    {
+        float64 sum[4] = { 0, 0, 0, 0 };
+        float64 sqsum[4] = { 0, 0, 0, 0 };
+        float64 max = 0;
+        int64 count = 0; // Pixels selected by mask
+
+        void merge(const SumStats& another)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                sum[c] += another.sum[c];
+                sqsum[c] += another.sqsum[c];
+            }
+            max = std::max(max, another.max);
+            count += another.count;
+        }
+    }; // struct SumStats
+
+    template<typename T, int Flags>
+    struct SumRow
+    {
+        static int simd(const T* /*src1*/, const T* /*src2*/, int /*width*/, int /*cn*/, SumStats& /*st*/)
+        {
+            return 0;
+        }
+    }; // struct SumRow
+
+    template<int Flags>
+    struct SumRow<uchar, Flags>
+    {
+        static void accumulate(v_uint8x16 v, v_int32x4& sum, v_int32x4& sqsum, v_uint8x16& max)
+        {
+            // Lane `j` of 32-bits sums gets elements `j`, `j + 4`, `j + 8` and `j + 12`
+            if (Flags & STAT_NONZERO)
+                v = v_min(v, v_setall_u8(1));
+            if (Flags & STAT_MAX)
+                max = v_max(max, v);
+
+            v_uint16x8 w0, w1;
+            v_expand(v, w0, w1);
+            const v_int16x8 x0 = v_reinterpret_as_s16(w0), x1 = v_reinterpret_as_s16(w1);
+            if (Flags & STAT_SUM)
+            {
+                v_int32x4 a0, a1, a2, a3;
+                v_expand(x0, a0, a1);
+                v_expand(x1, a2, a3);
+                sum = sum + ((a0 + a1) + (a2 + a3));
+            }
+            if (Flags & STAT_SQSUM)
+            {
+                v_int32x4 p0, p1, p2, p3;
+                v_mul_expand(x0, x0, p0, p1);
+                v_mul_expand(x1, x1, p2, p3);
+                sqsum = sqsum + ((p0 + p1) + (p2 + p3));
+            }
+        }
+
+        static v_uint8x16 absdiff(const v_uint8x16& a, const v_uint8x16& b)
+        {
+            return (a - b) | (b - a);
+        }
+
+        static int simd(const uchar* src1, const uchar* src2, int width, int cn, SumStats& st)
+        {
+            // Returns pixels processed
+            // Signed differences do not fit bytes, lanes of 1, 2 or 4 channels and 3 channels deinterleaved are handled
+            if ((src2 != NULL && !(Flags & STAT_ABS)) || cn > 4)
+                return 0;
+
+            // 32-bits lanes are flushed before 4096 iterations of squares can overflow
+            const int lanes = v_uint8x16::nlanes;
+            const int block = 4096 * lanes;
+            v_uint8x16 max = v_setzero_u8();
+            int buffer[4];
+            int x = 0;
+
+            if (cn == 3)
+            {
+                while (x <= width - lanes)
+                {
+                    v_int32x4 sum[3] = { v_setzero_s32(), v_setzero_s32(), v_setzero_s32() };
+                    v_int32x4 sqsum[3] = { v_setzero_s32(), v_setzero_s32(), v_setzero_s32() };
+                    const int end = std::min(width - lanes, x + block - lanes);
+                    for (; x <= end; x += lanes)
+                    {
+                        v_uint8x16 v[3];
+                        v_load_deinterleave(src1 + x * 3, v[0], v[1], v[2]);
+                        if (src2 != NULL)
+                        {
+                            v_uint8x16 u[3];
+                            v_load_deinterleave(src2 + x * 3, u[0], u[1], u[2]);
+                            for (int c = 0; c < 3; ++c)
+                                v[c] = absdiff(v[c], u[c]);
+                        }
+                        for (int c = 0; c < 3; ++c)
+                            accumulate(v[c], sum[c], sqsum[c], max);
+                    }
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        v_store(buffer, sum[c]);
+                        st.sum[c] += (float64)buffer[0] + buffer[1] + buffer[2] + buffer[3];
+                        v_store(buffer, sqsum[c]);
+                        st.sqsum[c] += (float64)buffer[0] + buffer[1] + buffer[2] + buffer[3];
+                    }
+                }
+            }
+            else
+            {
+                // Lanes are 4 elements apart, so lane `j` belongs to channel `j % cn`
+                const int n = width * cn;
+                while (x <= n - lanes)
+                {
+                    v_int32x4 sum = v_setzero_s32(), sqsum = v_setzero_s32();
+                    const int end = std::min(n - lanes, x + block - lanes);
+                    for (; x <= end; x += lanes)
+                    {
+                        v_uint8x16 v = v_load(src1 + x);
+                        if (src2 != NULL)
+                            v = absdiff(v, v_load(src2 + x));
+                        accumulate(v, sum, sqsum, max);
+                    }
+
+                    v_store(buffer, sum);
+                    for (int j = 0; j < 4; ++j)
+                        st.sum[j % cn] += buffer[j];
+                    v_store(buffer, sqsum);
+                    for (int j = 0; j < 4; ++j)
+                        st.sqsum[j % cn] += buffer[j];
+                }
+                x /= cn;
+            }
+
+            if (Flags & STAT_MAX)
+            {
+                uchar lanes_max[v_uint8x16::nlanes];
+                v_store(lanes_max, max);
+                st.max = std::max<float64>(st.max, *std::max_element(lanes_max, lanes_max + lanes));
+            }
+            return x;
+        }
+    }; // struct SumRow<uchar>
+
+    template<typename T, int Flags>
+    void sum_row(const T* src1, const T* src2, const uchar* mask, int width, int cn, SumStats& st)
+    {
+        // `src2` and `mask` are optional
+        int x = mask == NULL ? SumRow<T, Flags>::simd(src1, src2, simd_width(width), cn, st) : 0;
+        int64 count = x;
+        for (; x < width; ++x)
+        {
+            if (mask != NULL && mask[x] == 0)
+                continue;
+
+            ++count;
+            for (int c = 0; c < cn; ++c)
+            {
+                const int i = x * cn + c;
+                float64 v = src2 != NULL ? std::abs((float64)src1[i] - (float64)src2[i]) : (float64)src1[i];
+                if (Flags & STAT_ABS)
+                    v = std::abs(v);
+                if (Flags & STAT_NONZERO)
+                    v = v != 0 ? 1 : 0;
+                if (Flags & STAT_SUM)
+                    st.sum[c] += v;
+                if (Flags & STAT_SQSUM)
+                    st.sqsum[c] += v * v;
+                if (Flags & STAT_MAX)
+                    st.max = std::max(st.max, v);
+            }
+        }
+        st.count += count;
+    } // sum_row
+
+    template<typename T, int Flags>
+    SumStats sum_stats_of(const Matrix& src1, const Matrix& src2, const Matrix& mask)
+    {
+        const int cn = src1.channels();
+        const Size size = getContinuousSize(src1, src2, mask);
+
+        return parallel_reduce(size, cn, SumStats(), [&](SumStats& st, int y, int x, int width)
+        {
+            sum_row<T, Flags>(src1.ptr<T>(y) + x * cn, src2.empty() ? NULL : src2.ptr<T>(y) + x * cn,
+                mask.empty() ? NULL : mask.ptr(y) + x, width, cn, st);
+        });
+    } // sum_stats_of
+
+    template<int Flags>
+    SumStats sum_stats(const Matrix& src1, const Matrix& src2, const Matrix& mask)
+    {
+        // Up to 4 channels as `Scalar`
+        assert(src1.channels() <= 4);
+        check_reduce_args(src1, src2, mask);
+
+        const int depth = src1.depth();
+        if (depth == LCV_8U)
+            return sum_stats_of<uchar, Flags>(src1, src2, mask);
+        else if (depth == LCV_8S)
+            return sum_stats_of<schar, Flags>(src1, src2, mask);
+        else if (depth == LCV_16U)
+            return sum_stats_of<ushort, Flags>(src1, src2, mask);
+        else if (depth == LCV_16S)
+            return sum_stats_of<short, Flags>(src1, src2, mask);
+        else if (depth == LCV_32U)
+            return sum_stats_of<uint, Flags>(src1, src2, mask);
+        else if (depth == LCV_32S)
+            return sum_stats_of<int, Flags>(src1, src2, mask);
+        else if (depth == LCV_32F)
+            return sum_stats_of<float32, Flags>(src1, src2, mask);
+        else if (depth == LCV_64F)
+            return sum_stats_of<float64, Flags>(src1, src2, mask);
+
+        assert(0 && "Unsupported depth");
+        return SumStats();
+    } // sum_stats
+
+
+    /* ///////////////////////////////////////
+    *  //    Minimum and maximum
+    */ //
+    struct MinMaxStats
+    {
+        float64 min = DBL_MAX;
+        float64 max = -DBL_MAX;
+        int64 min_index = -1; // Raster index of pixel, `-1` when no pixel is selected
+        int64 max_index = -1;
+
+        void merge(const MinMaxStats& another)
+        {
+            // `another` follows in raster order, so first location is kept on ties
+            if (another.min_index >= 0 && (min_index < 0 || another.min < min))
+            {
+                min = another.min;
+                min_index = another.min_index;
+            }
+            if (another.max_index >= 0 && (max_index < 0 || another.max > max))
+            {
+                max = another.max;
+                max_index = another.max_index;
+            }
+        }
+    }; // struct MinMaxStats
+
+    template<typename T, bool = SimdTraits<T>::enabled != 0>
+    struct MinMaxRow
+    {
+        static void run(const T* src, int n, T& min, T& max)
+        {
+            min = max = src[0];
+            for (int i = 1; i < n; ++i)
+            {
+                min = std::min(min, src[i]);
+                max = std::max(max, src[i]);
+            }
+        }
+    }; // struct MinMaxRow
+
+    template<typename T>
+    struct MinMaxRow<T, true>
+    {
+        static void run(const T* src, int n, T& min, T& max)
+        {
+            using V = typename SimdTraits<T>::vec_type;
+
+            int i = 0;
+            min = max = src[0];
+            if (simd_width(n) >= V::nlanes)
+            {
+                V vmin = v_load(src), vmax = vmin;
+                for (i = V::nlanes; i <= n - V::nlanes; i += V::nlanes)
+                {
+                    const V v = v_load(src + i);
+                    vmin = v_min(vmin, v);
+                    vmax = v_max(vmax, v);
+                }
+
+                T lanes_min[V::nlanes], lanes_max[V::nlanes];
+                v_store(lanes_min, vmin);
+                v_store(lanes_max, vmax);
+                min = *std::min_element(lanes_min, lanes_min + V::nlanes);
+                max = *std::max_element(lanes_max, lanes_max + V::nlanes);
+            }
+
+            for (; i < n; ++i)
+            {
+                min = std::min(min, src[i]);
+                max = std::max(max, src[i]);
+            }
+        }
+    }; // struct MinMaxRow<T, true>
+
+    template<typename T>
+    void minmax_row(const T* src, const uchar* mask, int width, int64 index, MinMaxStats& st)
+    {
+        // `index` is raster index of the first pixel
+        if (mask == NULL)
+        {
+            // Locations are searched only when the scanline improves on the previous ones
+            T min, max;
+            MinMaxRow<T>::run(src, width, min, max);
+            if (st.min_index < 0 || min < st.min)
+            {
+                st.min = min;
+                st.min_index = index + (std::find(src, src + width, min) - src);
+            }
+            if (st.max_index < 0 || max > st.max)
+            {
+                st.max = max;
+                st.max_index = index + (std::find(src, src + width, max) - src);
+            }
+            return;
+        }
+
+        for (int x = 0; x < width; ++x)
+        {
+            if (mask[x] == 0)
+                continue;
+            if (st.min_index < 0 || src[x] < st.min)
+            {
+                st.min = src[x];
+                st.min_index = index + x;
+            }
+            if (st.max_index < 0 || src[x] > st.max)
+            {
+                st.max = src[x];
+                st.max_index = index + x;
+            }
+        }
+    } // minmax_row
+
+    template<typename T>
+    MinMaxStats minmax_stats_of(const Matrix& src, const Matrix& mask)
+    {
+        const Size size = getContinuousSize(src, Matrix(), mask);
+
+        return parallel_reduce(size, 1, MinMaxStats(), [&](MinMaxStats& st, int y, int x, int width)
+        {
+            minmax_row<T>(src.ptr<T>(y) + x, mask.empty() ? NULL : mask.ptr(y) + x, width, (int64)y * size.width + x, st);
+        });
+    } // minmax_stats_of
+
+
+    /* ///////////////////////////////////////
+    *  //    Reductions
+    */ //
+    Scalar inline sum(const Matrix& src)
+    {
+        const SumStats st = sum_stats<STAT_SUM>(src, Matrix(), Matrix());
+
+        Scalar s;
+        for (int c = 0; c < src.channels(); ++c)
+            s[c] = st.sum[c];
+        return s;
+    } // sum
+
+    int inline countNonZero(const Matrix& src)
+    {
+        // Only support single channel
+        assert(src.channels() == 1);
+
+        return (int)sum_stats<STAT_SUM | STAT_NONZERO>(src, Matrix(), Matrix()).sum[0];
+    } // countNonZero
+
+    Scalar inline mean(const Matrix& src, const Matrix& mask = Matrix())
+    {
+        // Zero when mask selects no pixel
+        const SumStats st = sum_stats<STAT_SUM>(src, Matrix(), mask);
+
+        Scalar s;
+        for (int c = 0; c < src.channels() && st.count > 0; ++c)
+            s[c] = st.sum[c] / st.count;
+        return s;
+    } // mean
+
+    void inline meanStdDev(const Matrix& src, Scalar& mean, Scalar& stddev, const Matrix& mask = Matrix())
+    {
+        const SumStats st = sum_stats<STAT_SUM | STAT_SQSUM>(src, Matrix(), mask);
+
+        mean = Scalar();
+        stddev = Scalar();
+        for (int c = 0; c < src.channels() && st.count > 0; ++c)
+        {
+            const float64 m = st.sum[c] / st.count;
+            mean[c] = m;
+            stddev[c] = std::sqrt(std::max(st.sqsum[c] / st.count - m * m, 0.));
+        }
+    } // meanStdDev
+
+    void inline minMaxLoc(const Matrix& src, double* minVal, double* maxVal = NULL, Point* minLoc = NULL, Point* maxLoc = NULL, const Matrix& mask = Matrix())
+    {
+        // Only support single channel
+        // Values are 0 and locations are (-1, -1) when mask selects no pixel
+        assert(src.channels() == 1);
+        check_reduce_args(src, Matrix(), mask);
+
+        MinMaxStats st;
+        const int depth = src.depth();
+        if (depth == LCV_8U)
+            st = minmax_stats_of<uchar>(src, mask);
+        else if (depth == LCV_8S)
+            st = minmax_stats_of<schar>(src, mask);
+        else if (depth == LCV_16U)
+            st = minmax_stats_of<ushort>(src, mask);
+        else if (depth == LCV_16S)
+            st = minmax_stats_of<short>(src, mask);
+        else if (depth == LCV_32U)
+            st = minmax_stats_of<uint>(src, mask);
+        else if (depth == LCV_32S)
+            st = minmax_stats_of<int>(src, mask);
+        else if (depth == LCV_32F)
+            st = minmax_stats_of<float32>(src, mask);
+        else if (depth == LCV_64F)
+            st = minmax_stats_of<float64>(src, mask);
+        else
+            assert(0 && "Unsupported depth");
+
+        auto location = [&](int64 index)
+        {
+            return index >= 0 ? Point((int)(index % src.cols), (int)(index / src.cols)) : Point(-1, -1);
+        };
+
+        if (minVal != NULL)
+            *minVal = st.min_index >= 0 ? st.min : 0;
+        if (maxVal != NULL)
+            *maxVal = st.max_index >= 0 ? st.max : 0;
+        if (minLoc != NULL)
+            *minLoc = location(st.min_index);
+        if (maxLoc != NULL)
+            *maxLoc = location(st.max_index);
+    } // minMaxLoc
+
+    double inline norm(const Matrix& src1, const Matrix& src2, int normType = NORM_L2, const Matrix& mask = Matrix())
+    {
+        // Norm of `src1 - src2` over all channels, `src2` can be empty
+        if (normType == NORM_INF)
+            return sum_stats<STAT_ABS | STAT_MAX>(src1, src2, mask).max;
+
+        if (normType == NORM_L1)
+        {
+            const SumStats st = sum_stats<STAT_ABS | STAT_SUM>(src1, src2, mask);
+            return st.sum[0] + st.sum[1] + st.sum[2] + st.sum[3];
+        }
+
+        assert(normType == NORM_L2);
+        const SumStats st = sum_stats<STAT_ABS | STAT_SQSUM>(src1, src2, mask);
+        return std::sqrt(st.sqsum[0] + st.sqsum[1] + st.sqsum[2] + st.sqsum[3]);
+    } // norm
+
+    double inline norm(const Matrix& src, int normType = NORM_L2, const Matrix& mask = Matrix())
+    {
+        return norm(src, Matrix(), normType, mask);
+    } // norm
+} // namespace lcv
+#endif // LCV_CORE_REDUCE_HPP
@@ -2,9 +2,12 @@
 #ifndef LCV_CORE_SATURATE_HPP
 #define LCV_CORE_SATURATE_HPP
 #include <utility>
+#include <algorithm>
+#include <cmath>
 
 #include "lcvdef.hpp"
 #include "lcvmath.hpp"
+#include "cpu.hpp"
 
 
 namespace lcv
@@ -240,13 +243,23 @@ namespace lcv
     template<>
     uint inline saturate_cast<uint>(float32 v)
     {
-        return (uint)lcvRound(v);
+        // Beyond the range of `lcvRound`
+        if (v <= 0)
+            return 0;
+        if (v >= (float32)UINT32_MAX)
+            return UINT32_MAX;
+        return (uint)std::llrint(v);
     }
 
     template<>
     uint inline saturate_cast<uint>(float64 v)
     {
-        return (uint)lcvRound(v);
+        // Beyond the range of `lcvRound`
+        if (v <= 0)
+            return 0;
+        if (v >= (float64)UINT32_MAX)
+            return UINT32_MAX;
+        return (uint)std::llrint(v);
     }
 
     template<>
@@ -266,5 +279,558 @@ namespace lcv
     {
         return lcvRound(v);
     }
+
+
+    /* ///////////////////////////////////////
+    *  //    Buffer conversion
+    */ //
+    // Each vector variant converts leading elements with pack instructions, hands the rest to the narrower variant
+    // and returns how many elements were converted, `saturate_row` picks the variant of the CPU level
+    // Vector code rounds half to even and saturates as scalar `saturate_cast`
+    template<typename ST, typename DT>
+    struct SaturateRow
+    {
+        static int simd(const ST* /*src*/, DT* /*dst*/, int /*n*/)
+        {
+            return 0;
+        }
+    }; // struct SaturateRow
+
+    template<typename Impl, typename ST, typename DT>
+    int inline saturate_row(const ST* src, DT* dst, int n)
+    {
+#if defined(LCV_X86)
+        const int level = getCpuLevel();
+        if (level >= CPU_LEVEL_AVX512)
+            return Impl::avx512(src, dst, n);
+        if (level >= CPU_LEVEL_AVX2)
+            return Impl::avx2(src, dst, n);
+        if (level >= CPU_LEVEL_SSE2)
+            return Impl::sse2(src, dst, n);
+#elif defined(LCV_NEON)
+        if (getCpuLevel() >= CPU_LEVEL_SSE2)
+            return Impl::neon(src, dst, n);
+#endif
+        return 0;
+    } // saturate_row
+
+    template<>
+    struct SaturateRow<float32, uchar>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const float32* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m128i v0 = _mm_cvtps_epi32(_mm_loadu_ps(src + i));
+                const __m128i v1 = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 4));
+                const __m128i v2 = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 8));
+                const __m128i v3 = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 12));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const float32* src, uchar* dst, int n)
+        {
+            const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            int i = 0;
+            for (; i <= n - 32; i += 32)
+            {
+                const __m256i v0 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i));
+                const __m256i v1 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i + 8));
+                const __m256i v2 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i + 16));
+                const __m256i v3 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i + 24));
+
+                // Packs work in 128-bits lanes, restore order of 32-bits groups
+                const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(v0, v1), _mm256_packs_epi32(v2, v3));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const float32* src, uchar* dst, int n)
+        {
+            // Negative values are cut first because down-conversion saturates as unsigned
+            const __m512i zero = _mm512_setzero_si512();
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m512i v = _mm512_max_epi32(_mm512_cvtps_epi32(_mm512_loadu_ps(src + i)), zero);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm512_cvtusepi32_epi8(v));
+            }
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const float32* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+            {
+                const int16x8_t v = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(src + i))), vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(src + i + 4))));
+                vst1_u8(dst + i, vqmovun_s16(v));
+            }
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const float32* src, uchar* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<float32, uchar>
+
+    template<>
+    struct SaturateRow<int, uchar>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const int* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+                const __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 4));
+                const __m128i v2 = _mm_loadu_si128((const __m128i*)(src + i + 8));
+                const __m128i v3 = _mm_loadu_si128((const __m128i*)(src + i + 12));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const int* src, uchar* dst, int n)
+        {
+            const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            int i = 0;
+            for (; i <= n - 32; i += 32)
+            {
+                const __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+                const __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+                const __m256i v2 = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+                const __m256i v3 = _mm256_loadu_si256((const __m256i*)(src + i + 24));
+
+                const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(v0, v1), _mm256_packs_epi32(v2, v3));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const int* src, uchar* dst, int n)
+        {
+            const __m512i zero = _mm512_setzero_si512();
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m512i v = _mm512_max_epi32(_mm512_loadu_si512((const void*)(src + i)), zero);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm512_cvtusepi32_epi8(v));
+            }
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const int* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+            {
+                const int16x8_t v = vcombine_s16(vqmovn_s32(vld1q_s32(src + i)), vqmovn_s32(vld1q_s32(src + i + 4)));
+                vst1_u8(dst + i, vqmovun_s16(v));
+            }
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const int* src, uchar* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<int, uchar>
+
+    template<>
+    struct SaturateRow<short, uchar>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const short* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+                const __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 8));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(v0, v1));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const short* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 32; i += 32)
+            {
+                const __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+                const __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xD8));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f,avx512bw") static int avx512(const short* src, uchar* dst, int n)
+        {
+            const __m512i zero = _mm512_setzero_si512();
+            int i = 0;
+            for (; i <= n - 32; i += 32)
+            {
+                const __m512i v = _mm512_max_epi16(_mm512_loadu_si512((const void*)(src + i)), zero);
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtusepi16_epi8(v));
+            }
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const short* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+                vst1_u8(dst + i, vqmovun_s16(vld1q_s16(src + i)));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const short* src, uchar* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<short, uchar>
+
+    template<>
+    struct SaturateRow<ushort, uchar>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const ushort* src, uchar* dst, int n)
+        {
+            // min(v, 255) as v - max(v - 255, 0), SSE2 has no unsigned 16-bits min
+            const __m128i max = _mm_set1_epi16(UINT8_MAX);
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+                __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 8));
+                v0 = _mm_sub_epi16(v0, _mm_subs_epu16(v0, max));
+                v1 = _mm_sub_epi16(v1, _mm_subs_epu16(v1, max));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(v0, v1));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const ushort* src, uchar* dst, int n)
+        {
+            const __m256i max = _mm256_set1_epi16(UINT8_MAX);
+            int i = 0;
+            for (; i <= n - 32; i += 32)
+            {
+                const __m256i v0 = _mm256_min_epu16(_mm256_loadu_si256((const __m256i*)(src + i)), max);
+                const __m256i v1 = _mm256_min_epu16(_mm256_loadu_si256((const __m256i*)(src + i + 16)), max);
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xD8));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f,avx512bw") static int avx512(const ushort* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 32; i += 32)
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtusepi16_epi8(_mm512_loadu_si512((const void*)(src + i))));
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const ushort* src, uchar* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+                vst1_u8(dst + i, vqmovn_u16(vld1q_u16(src + i)));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const ushort* src, uchar* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<ushort, uchar>
+
+    template<>
+    struct SaturateRow<int, short>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const int* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+            {
+                const __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+                const __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 4));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(v0, v1));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const int* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+                const __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(v0, v1), 0xD8));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const int* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtsepi32_epi16(_mm512_loadu_si512((const void*)(src + i))));
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const int* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 4; i += 4)
+                vst1_s16(dst + i, vqmovn_s32(vld1q_s32(src + i)));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const int* src, short* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<int, short>
+
+    template<>
+    struct SaturateRow<float32, short>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const float32* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+            {
+                const __m128i v0 = _mm_cvtps_epi32(_mm_loadu_ps(src + i));
+                const __m128i v1 = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 4));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(v0, v1));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const float32* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m256i v0 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i));
+                const __m256i v1 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i + 8));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(v0, v1), 0xD8));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const float32* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(_mm512_loadu_ps(src + i))));
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const float32* src, short* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 4; i += 4)
+                vst1_s16(dst + i, vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(src + i))));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const float32* src, short* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<float32, short>
+
+    template<>
+    struct SaturateRow<int, ushort>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const int* src, ushort* dst, int n)
+        {
+            // Shift into signed range for the signed pack and shift back, SSE2 has no unsigned 32-bits pack
+            // Negative lanes are cleared first, shifting them would wrap below INT_MIN
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias32 = _mm_set1_epi32(32768), bias16 = _mm_set1_epi16(-32768);
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+            {
+                __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+                __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 4));
+                v0 = _mm_sub_epi32(_mm_and_si128(v0, _mm_cmpgt_epi32(v0, zero)), bias32);
+                v1 = _mm_sub_epi32(_mm_and_si128(v1, _mm_cmpgt_epi32(v1, zero)), bias32);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_packs_epi32(v0, v1), bias16));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const int* src, ushort* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+                const __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), 0xD8));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const int* src, ushort* dst, int n)
+        {
+            const __m512i zero = _mm512_setzero_si512();
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m512i v = _mm512_max_epi32(_mm512_loadu_si512((const void*)(src + i)), zero);
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtusepi32_epi16(v));
+            }
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const int* src, ushort* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 4; i += 4)
+                vst1_u16(dst + i, vqmovun_s32(vld1q_s32(src + i)));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const int* src, ushort* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<int, ushort>
+
+    template<>
+    struct SaturateRow<float32, ushort>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const float32* src, ushort* dst, int n)
+        {
+            // Shift into signed range for the signed pack, NaN and out of range elements are INT_MIN
+            // Negative lanes are cleared first, shifting them would wrap below INT_MIN
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias32 = _mm_set1_epi32(32768), bias16 = _mm_set1_epi16(-32768);
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+            {
+                __m128i v0 = _mm_cvtps_epi32(_mm_loadu_ps(src + i));
+                __m128i v1 = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 4));
+                v0 = _mm_sub_epi32(_mm_and_si128(v0, _mm_cmpgt_epi32(v0, zero)), bias32);
+                v1 = _mm_sub_epi32(_mm_and_si128(v1, _mm_cmpgt_epi32(v1, zero)), bias32);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_packs_epi32(v0, v1), bias16));
+            }
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const float32* src, ushort* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m256i v0 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i));
+                const __m256i v1 = _mm256_cvtps_epi32(_mm256_loadu_ps(src + i + 8));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), 0xD8));
+            }
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const float32* src, ushort* dst, int n)
+        {
+            const __m512i zero = _mm512_setzero_si512();
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+            {
+                const __m512i v = _mm512_max_epi32(_mm512_cvtps_epi32(_mm512_loadu_ps(src + i)), zero);
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtusepi32_epi16(v));
+            }
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const float32* src, ushort* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 4; i += 4)
+                vst1_u16(dst + i, vqmovun_s32(vcvtnq_s32_f32(vld1q_f32(src + i))));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const float32* src, ushort* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<float32, ushort>
+
+    template<>
+    struct SaturateRow<float32, int>
+    {
+#if defined(LCV_X86)
+        LCV_TARGET("sse2") static int sse2(const float32* src, int* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 4; i += 4)
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_cvtps_epi32(_mm_loadu_ps(src + i)));
+            return i;
+        }
+
+        LCV_TARGET("avx2") static int avx2(const float32* src, int* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 8; i += 8)
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtps_epi32(_mm256_loadu_ps(src + i)));
+            return i + sse2(src + i, dst + i, n - i);
+        }
+
+        LCV_TARGET("avx512f") static int avx512(const float32* src, int* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 16; i += 16)
+                _mm512_storeu_si512((void*)(dst + i), _mm512_cvtps_epi32(_mm512_loadu_ps(src + i)));
+            return i + avx2(src + i, dst + i, n - i);
+        }
+#elif defined(LCV_NEON)
+        static int neon(const float32* src, int* dst, int n)
+        {
+            int i = 0;
+            for (; i <= n - 4; i += 4)
+                vst1q_s32(dst + i, vcvtnq_s32_f32(vld1q_f32(src + i)));
+            return i;
+        }
+#endif // LCV_X86
+
+        static int simd(const float32* src, int* dst, int n)
+        {
+            return saturate_row<SaturateRow>(src, dst, n);
+        }
+    }; // struct SaturateRow<float32, int>
+
+    template<typename DT, typename ST>
+    void inline saturate_cast(const ST* src, DT* dst, int n)
+    {
+        // Convert `n` elements, e.g. `saturate_cast<uchar>(row_sums, scanline, width)`
+        int i = SaturateRow<ST, DT>::simd(src, dst, n);
+        for (; i < n; ++i)
+            dst[i] = saturate_cast<DT>(src[i]);
+    } // saturate_cast
 } // namespace lcv
 #endif // LCV_CORE_SATURATE_HPP
@@ -0,0 +1,1042 @@
+#pragma once
+#ifndef LCV_CORE_SIMD_HPP
+#define LCV_CORE_SIMD_HPP
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "lcvdef.hpp"
+#include "saturate.hpp"
+
+
+// Universal intrinsics
+// Fixed-width 128-bits registers written once and compiled to SSE2 on x86, NEON on AArch64 or plain arrays elsewhere
+// x86 code is VEX-encoded in AVX2 builds and inside `cpu_dispatch`
+//
+// Arithmetic of 8-bits and 16-bits lanes saturates, arithmetic of 32-bits lanes wraps
+// Shift counts and `v_extract` offsets are compile-time constants, right shifts need count of 1 or more
+#if defined(LCV_SSE2) || defined(LCV_NEON)
+#define LCV_SIMD128 1
+#endif
+
+namespace lcv
+{
+#if defined(LCV_SSE2)
+    /* ///////////////////////////////////////
+    *  //    SSE2 registers
+    */ //
+    struct v_uint8x16
+    {
+        using lane_type = uchar;
+        enum { nlanes = 16 };
+
+        v_uint8x16() = default;
+        explicit v_uint8x16(__m128i v) : val(v) {}
+
+        __m128i val;
+    }; // struct v_uint8x16
+
+    struct v_uint16x8
+    {
+        using lane_type = ushort;
+        enum { nlanes = 8 };
+
+        v_uint16x8() = default;
+        explicit v_uint16x8(__m128i v) : val(v) {}
+
+        __m128i val;
+    }; // struct v_uint16x8
+
+    struct v_int16x8
+    {
+        using lane_type = short;
+        enum { nlanes = 8 };
+
+        v_int16x8() = default;
+        explicit v_int16x8(__m128i v) : val(v) {}
+
+        __m128i val;
+    }; // struct v_int16x8
+
+    struct v_int32x4
+    {
+        using lane_type = int;
+        enum { nlanes = 4 };
+
+        v_int32x4() = default;
+        explicit v_int32x4(__m128i v) : val(v) {}
+
+        __m128i val;
+    }; // struct v_int32x4
+
+    struct v_float32x4
+    {
+        using lane_type = float32;
+        enum { nlanes = 4 };
+
+        v_float32x4() = default;
+        explicit v_float32x4(__m128 v) : val(v) {}
+
+        __m128 val;
+    }; // struct v_float32x4
+
+
+    /* ///////////////////////////////////////
+    *  //    SSE2 load, store and initialization
+    */ //
+    v_uint8x16 inline v_load(const uchar* ptr) { return v_uint8x16(_mm_loadu_si128((const __m128i*)ptr)); }
+    v_uint16x8 inline v_load(const ushort* ptr) { return v_uint16x8(_mm_loadu_si128((const __m128i*)ptr)); }
+    v_int16x8 inline v_load(const short* ptr) { return v_int16x8(_mm_loadu_si128((const __m128i*)ptr)); }
+    v_int32x4 inline v_load(const int* ptr) { return v_int32x4(_mm_loadu_si128((const __m128i*)ptr)); }
+    v_float32x4 inline v_load(const float32* ptr) { return v_float32x4(_mm_loadu_ps(ptr)); }
+
+    void inline v_store(uchar* ptr, const v_uint8x16& a) { _mm_storeu_si128((__m128i*)ptr, a.val); }
+    void inline v_store(ushort* ptr, const v_uint16x8& a) { _mm_storeu_si128((__m128i*)ptr, a.val); }
+    void inline v_store(short* ptr, const v_int16x8& a) { _mm_storeu_si128((__m128i*)ptr, a.val); }
+    void inline v_store(int* ptr, const v_int32x4& a) { _mm_storeu_si128((__m128i*)ptr, a.val); }
+    void inline v_store(float32* ptr, const v_float32x4& a) { _mm_storeu_ps(ptr, a.val); }
+
+    v_uint8x16 inline v_setall_u8(uchar v) { return v_uint8x16(_mm_set1_epi8((char)v)); }
+    v_uint16x8 inline v_setall_u16(ushort v) { return v_uint16x8(_mm_set1_epi16((short)v)); }
+    v_int16x8 inline v_setall_s16(short v) { return v_int16x8(_mm_set1_epi16(v)); }
+    v_int32x4 inline v_setall_s32(int v) { return v_int32x4(_mm_set1_epi32(v)); }
+    v_float32x4 inline v_setall_f32(float32 v) { return v_float32x4(_mm_set1_ps(v)); }
+
+    v_uint8x16 inline v_setzero_u8() { return v_uint8x16(_mm_setzero_si128()); }
+    v_uint16x8 inline v_setzero_u16() { return v_uint16x8(_mm_setzero_si128()); }
+    v_int16x8 inline v_setzero_s16() { return v_int16x8(_mm_setzero_si128()); }
+    v_int32x4 inline v_setzero_s32() { return v_int32x4(_mm_setzero_si128()); }
+    v_float32x4 inline v_setzero_f32() { return v_float32x4(_mm_setzero_ps()); }
+
+
+    /* ///////////////////////////////////////
+    *  //    SSE2 arithmetic
+    */ //
+    v_uint8x16 inline operator+(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_adds_epu8(a.val, b.val)); }
+    v_uint16x8 inline operator+(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(_mm_adds_epu16(a.val, b.val)); }
+    v_int16x8 inline operator+(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(_mm_adds_epi16(a.val, b.val)); }
+    v_int32x4 inline operator+(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(_mm_add_epi32(a.val, b.val)); }
+    v_float32x4 inline operator+(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(_mm_add_ps(a.val, b.val)); }
+
+    v_uint8x16 inline operator-(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_subs_epu8(a.val, b.val)); }
+    v_uint16x8 inline operator-(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(_mm_subs_epu16(a.val, b.val)); }
+    v_int16x8 inline operator-(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(_mm_subs_epi16(a.val, b.val)); }
+    v_int32x4 inline operator-(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(_mm_sub_epi32(a.val, b.val)); }
+    v_float32x4 inline operator-(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(_mm_sub_ps(a.val, b.val)); }
+
+    v_int32x4 inline operator*(const v_int32x4& a, const v_int32x4& b)
+    {
+        // SSE2 multiplies only even lanes into 64-bits, multiply odd lanes separately and gather low halves
+        const __m128i even = _mm_mul_epu32(a.val, b.val);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.val, 32), _mm_srli_epi64(b.val, 32));
+        return v_int32x4(_mm_unpacklo_epi64(_mm_unpacklo_epi32(even, odd), _mm_unpackhi_epi32(even, odd)));
+    }
+    v_float32x4 inline operator*(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(_mm_mul_ps(a.val, b.val)); }
+    v_float32x4 inline operator/(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(_mm_div_ps(a.val, b.val)); }
+
+    v_uint8x16 inline operator&(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_and_si128(a.val, b.val)); }
+    v_uint8x16 inline operator|(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_or_si128(a.val, b.val)); }
+    v_uint8x16 inline operator^(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_xor_si128(a.val, b.val)); }
+
+    v_uint8x16 inline v_min(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_min_epu8(a.val, b.val)); }
+    v_uint8x16 inline v_max(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(_mm_max_epu8(a.val, b.val)); }
+    v_uint16x8 inline v_min(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(_mm_sub_epi16(a.val, _mm_subs_epu16(a.val, b.val))); }
+    v_uint16x8 inline v_max(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(_mm_add_epi16(b.val, _mm_subs_epu16(a.val, b.val))); }
+    v_int16x8 inline v_min(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(_mm_min_epi16(a.val, b.val)); }
+    v_int16x8 inline v_max(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(_mm_max_epi16(a.val, b.val)); }
+    v_int32x4 inline v_min(const v_int32x4& a, const v_int32x4& b)
+    {
+        const __m128i gt = _mm_cmpgt_epi32(a.val, b.val);
+        return v_int32x4(_mm_or_si128(_mm_and_si128(gt, b.val), _mm_andnot_si128(gt, a.val)));
+    }
+    v_int32x4 inline v_max(const v_int32x4& a, const v_int32x4& b)
+    {
+        const __m128i gt = _mm_cmpgt_epi32(a.val, b.val);
+        return v_int32x4(_mm_or_si128(_mm_and_si128(gt, a.val), _mm_andnot_si128(gt, b.val)));
+    }
+    v_float32x4 inline v_min(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(_mm_min_ps(a.val, b.val)); }
+    v_float32x4 inline v_max(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(_mm_max_ps(a.val, b.val)); }
+
+    template<int n> v_uint16x8 inline v_shl(const v_uint16x8& a) { return v_uint16x8(_mm_slli_epi16(a.val, n)); }
+    template<int n> v_int16x8 inline v_shl(const v_int16x8& a) { return v_int16x8(_mm_slli_epi16(a.val, n)); }
+    template<int n> v_int32x4 inline v_shl(const v_int32x4& a) { return v_int32x4(_mm_slli_epi32(a.val, n)); }
+    template<int n> v_uint16x8 inline v_shr(const v_uint16x8& a) { return v_uint16x8(_mm_srli_epi16(a.val, n)); }
+    template<int n> v_int16x8 inline v_shr(const v_int16x8& a) { return v_int16x8(_mm_srai_epi16(a.val, n)); }
+    template<int n> v_int32x4 inline v_shr(const v_int32x4& a) { return v_int32x4(_mm_srai_epi32(a.val, n)); }
+
+
+    /* ///////////////////////////////////////
+    *  //    SSE2 widening and narrowing
+    */ //
+    v_uint16x8 inline v_mul_hi(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(_mm_mulhi_epu16(a.val, b.val)); }
+
+    void inline v_mul_expand(const v_int16x8& a, const v_int16x8& b, v_int32x4& c0, v_int32x4& c1)
+    {
+        const __m128i lo = _mm_mullo_epi16(a.val, b.val);
+        const __m128i hi = _mm_mulhi_epi16(a.val, b.val);
+        c0.val = _mm_unpacklo_epi16(lo, hi);
+        c1.val = _mm_unpackhi_epi16(lo, hi);
+    }
+
+    v_int32x4 inline v_dotprod(const v_int16x8& a, const v_int16x8& b) { return v_int32x4(_mm_madd_epi16(a.val, b.val)); }
+
+    void inline v_expand(const v_uint8x16& a, v_uint16x8& b0, v_uint16x8& b1)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        b0.val = _mm_unpacklo_epi8(a.val, zero);
+        b1.val = _mm_unpackhi_epi8(a.val, zero);
+    }
+
+    void inline v_expand(const v_int16x8& a, v_int32x4& b0, v_int32x4& b1)
+    {
+        // Duplicate into upper halves and shift back to extend the sign
+        b0.val = _mm_srai_epi32(_mm_unpacklo_epi16(a.val, a.val), 16);
+        b1.val = _mm_srai_epi32(_mm_unpackhi_epi16(a.val, a.val), 16);
+    }
+
+    v_uint8x16 inline v_pack(const v_uint16x8& a, const v_uint16x8& b)
+    {
+        const __m128i max = _mm_set1_epi16(UINT8_MAX);
+        const __m128i a8 = _mm_sub_epi16(a.val, _mm_subs_epu16(a.val, max));
+        const __m128i b8 = _mm_sub_epi16(b.val, _mm_subs_epu16(b.val, max));
+        return v_uint8x16(_mm_packus_epi16(a8, b8));
+    }
+
+    v_uint8x16 inline v_pack_u(const v_int16x8& a, const v_int16x8& b) { return v_uint8x16(_mm_packus_epi16(a.val, b.val)); }
+    v_int16x8 inline v_pack(const v_int32x4& a, const v_int32x4& b) { return v_int16x8(_mm_packs_epi32(a.val, b.val)); }
+
+    v_uint16x8 inline v_pack_u(const v_int32x4& a, const v_int32x4& b)
+    {
+        // Shift into signed range for the signed pack and shift back
+        // Negative lanes are cleared first, shifting them would wrap below INT_MIN
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias32 = _mm_set1_epi32(32768), bias16 = _mm_set1_epi16(-32768);
+        const __m128i a0 = _mm_and_si128(a.val, _mm_cmpgt_epi32(a.val, zero));
+        const __m128i b0 = _mm_and_si128(b.val, _mm_cmpgt_epi32(b.val, zero));
+        const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a0, bias32), _mm_sub_epi32(b0, bias32));
+        return v_uint16x8(_mm_xor_si128(packed, bias16));
+    }
+
+    v_int16x8 inline v_reinterpret_as_s16(const v_uint16x8& a) { return v_int16x8(a.val); }
+    v_uint16x8 inline v_reinterpret_as_u16(const v_int16x8& a) { return v_uint16x8(a.val); }
+
+    v_float32x4 inline v_cvt_f32(const v_int32x4& a) { return v_float32x4(_mm_cvtepi32_ps(a.val)); }
+    v_int32x4 inline v_round(const v_float32x4& a) { return v_int32x4(_mm_cvtps_epi32(a.val)); }
+
+
+    /* ///////////////////////////////////////
+    *  //    SSE2 shuffles
+    */ //
+    void inline v_zip(const v_uint8x16& a, const v_uint8x16& b, v_uint8x16& c0, v_uint8x16& c1)
+    {
+        c0.val = _mm_unpacklo_epi8(a.val, b.val);
+        c1.val = _mm_unpackhi_epi8(a.val, b.val);
+    }
+
+    void inline v_zip(const v_uint16x8& a, const v_uint16x8& b, v_uint16x8& c0, v_uint16x8& c1)
+    {
+        c0.val = _mm_unpacklo_epi16(a.val, b.val);
+        c1.val = _mm_unpackhi_epi16(a.val, b.val);
+    }
+
+    void inline v_zip(const v_int16x8& a, const v_int16x8& b, v_int16x8& c0, v_int16x8& c1)
+    {
+        c0.val = _mm_unpacklo_epi16(a.val, b.val);
+        c1.val = _mm_unpackhi_epi16(a.val, b.val);
+    }
+
+    void inline v_zip(const v_int32x4& a, const v_int32x4& b, v_int32x4& c0, v_int32x4& c1)
+    {
+        c0.val = _mm_unpacklo_epi32(a.val, b.val);
+        c1.val = _mm_unpackhi_epi32(a.val, b.val);
+    }
+
+    void inline v_zip(const v_float32x4& a, const v_float32x4& b, v_float32x4& c0, v_float32x4& c1)
+    {
+        c0.val = _mm_unpacklo_ps(a.val, b.val);
+        c1.val = _mm_unpackhi_ps(a.val, b.val);
+    }
+
+    template<int n>
+    v_uint8x16 inline v_extract(const v_uint8x16& a, const v_uint8x16& b)
+    {
+        // Lanes `n` .. `n + 15` of concatenated `a` and `b`
+        return v_uint8x16(_mm_or_si128(_mm_srli_si128(a.val, n), _mm_slli_si128(b.val, 16 - n)));
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    SSE2 interleaved channels
+    */ //
+    void inline v_transpose_4channels(__m128i u0, __m128i u1, __m128i u2, __m128i u3, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c, v_uint8x16& d)
+    {
+        // Transpose 16 pixels of 4 bytes by rounds of byte unpacking
+        __m128i v0 = _mm_unpacklo_epi8(u0, u2);
+        __m128i v1 = _mm_unpackhi_epi8(u0, u2);
+        __m128i v2 = _mm_unpacklo_epi8(u1, u3);
+        __m128i v3 = _mm_unpackhi_epi8(u1, u3);
+
+        u0 = _mm_unpacklo_epi8(v0, v2);
+        u1 = _mm_unpacklo_epi8(v1, v3);
+        u2 = _mm_unpackhi_epi8(v0, v2);
+        u3 = _mm_unpackhi_epi8(v1, v3);
+
+        v0 = _mm_unpacklo_epi8(u0, u1);
+        v1 = _mm_unpacklo_epi8(u2, u3);
+        v2 = _mm_unpackhi_epi8(u0, u1);
+        v3 = _mm_unpackhi_epi8(u2, u3);
+
+        a.val = _mm_unpacklo_epi8(v0, v1);
+        b.val = _mm_unpackhi_epi8(v0, v1);
+        c.val = _mm_unpacklo_epi8(v2, v3);
+        d.val = _mm_unpackhi_epi8(v2, v3);
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c, v_uint8x16& d)
+    {
+        const __m128i u0 = _mm_loadu_si128((const __m128i*)ptr);
+        const __m128i u1 = _mm_loadu_si128((const __m128i*)(ptr + 16));
+        const __m128i u2 = _mm_loadu_si128((const __m128i*)(ptr + 32));
+        const __m128i u3 = _mm_loadu_si128((const __m128i*)(ptr + 48));
+        v_transpose_4channels(u0, u1, u2, u3, a, b, c, d);
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b, const v_uint8x16& c, const v_uint8x16& d)
+    {
+        const __m128i ab0 = _mm_unpacklo_epi8(a.val, b.val);
+        const __m128i ab1 = _mm_unpackhi_epi8(a.val, b.val);
+        const __m128i cd0 = _mm_unpacklo_epi8(c.val, d.val);
+        const __m128i cd1 = _mm_unpackhi_epi8(c.val, d.val);
+
+        _mm_storeu_si128((__m128i*)ptr, _mm_unpacklo_epi16(ab0, cd0));
+        _mm_storeu_si128((__m128i*)(ptr + 16), _mm_unpackhi_epi16(ab0, cd0));
+        _mm_storeu_si128((__m128i*)(ptr + 32), _mm_unpacklo_epi16(ab1, cd1));
+        _mm_storeu_si128((__m128i*)(ptr + 48), _mm_unpackhi_epi16(ab1, cd1));
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b)
+    {
+        // Even bytes are the low halves of 16-bits lanes, odd bytes the high halves
+        const __m128i mask = _mm_set1_epi16(0x00FF);
+        const __m128i u0 = _mm_loadu_si128((const __m128i*)ptr);
+        const __m128i u1 = _mm_loadu_si128((const __m128i*)(ptr + 16));
+        a.val = _mm_packus_epi16(_mm_and_si128(u0, mask), _mm_and_si128(u1, mask));
+        b.val = _mm_packus_epi16(_mm_srli_epi16(u0, 8), _mm_srli_epi16(u1, 8));
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b)
+    {
+        _mm_storeu_si128((__m128i*)ptr, _mm_unpacklo_epi8(a.val, b.val));
+        _mm_storeu_si128((__m128i*)(ptr + 16), _mm_unpackhi_epi8(a.val, b.val));
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c)
+    {
+        // Spread 3-bytes pixels into 4-bytes pixels and deinterleave them as 4 channels
+        const __m128i mask = _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF);
+        const __m128i u0 = _mm_loadu_si128((const __m128i*)ptr);
+        const __m128i u1 = _mm_loadu_si128((const __m128i*)(ptr + 16));
+        const __m128i u2 = _mm_loadu_si128((const __m128i*)(ptr + 32));
+
+        // Four pixels in the low 12 bytes of each register
+        __m128i p[4] = {
+            u0,
+            _mm_or_si128(_mm_srli_si128(u0, 12), _mm_slli_si128(u1, 4)),
+            _mm_or_si128(_mm_srli_si128(u1, 8), _mm_slli_si128(u2, 8)),
+            _mm_srli_si128(u2, 4)
+        };
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // Two pixels per 64-bits half, second pixel moved from byte 3 to byte 4
+            const __m128i t = _mm_unpacklo_epi64(p[i], _mm_srli_si128(p[i], 6));
+            p[i] = _mm_or_si128(_mm_and_si128(t, mask), _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(t, 24), mask), 32));
+        }
+
+        v_uint8x16 d;
+        v_transpose_4channels(p[0], p[1], p[2], p[3], a, b, c, d);
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b, const v_uint8x16& c)
+    {
+        // Interleave as 4-bytes pixels and squeeze out the fourth bytes
+        const __m128i mask = _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF);
+        const __m128i low = _mm_set_epi32(0, 0, 0xFFFF, -1);
+        const __m128i high = _mm_set_epi32(0, -1, 0xFFFF0000, 0);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ab0 = _mm_unpacklo_epi8(a.val, b.val);
+        const __m128i ab1 = _mm_unpackhi_epi8(a.val, b.val);
+        const __m128i c0 = _mm_unpacklo_epi8(c.val, zero);
+        const __m128i c1 = _mm_unpackhi_epi8(c.val, zero);
+        __m128i p[4] = {
+            _mm_unpacklo_epi16(ab0, c0), _mm_unpackhi_epi16(ab0, c0),
+            _mm_unpacklo_epi16(ab1, c1), _mm_unpackhi_epi16(ab1, c1)
+        };
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // 6 bytes per 64-bits half, then join halves into the low 12 bytes
+            const __m128i t = _mm_or_si128(_mm_and_si128(p[i], mask), _mm_srli_epi64(_mm_andnot_si128(mask, p[i]), 8));
+            p[i] = _mm_or_si128(_mm_and_si128(t, low), _mm_and_si128(_mm_srli_si128(t, 2), high));
+        }
+
+        _mm_storeu_si128((__m128i*)ptr, _mm_or_si128(p[0], _mm_slli_si128(p[1], 12)));
+        _mm_storeu_si128((__m128i*)(ptr + 16), _mm_or_si128(_mm_srli_si128(p[1], 4), _mm_slli_si128(p[2], 8)));
+        _mm_storeu_si128((__m128i*)(ptr + 32), _mm_or_si128(_mm_srli_si128(p[2], 8), _mm_slli_si128(p[3], 4)));
+    }
+
+#elif defined(LCV_NEON)
+    /* ///////////////////////////////////////
+    *  //    NEON registers
+    */ //
+    struct v_uint8x16
+    {
+        using lane_type = uchar;
+        enum { nlanes = 16 };
+
+        v_uint8x16() = default;
+        explicit v_uint8x16(uint8x16_t v) : val(v) {}
+
+        uint8x16_t val;
+    }; // struct v_uint8x16
+
+    struct v_uint16x8
+    {
+        using lane_type = ushort;
+        enum { nlanes = 8 };
+
+        v_uint16x8() = default;
+        explicit v_uint16x8(uint16x8_t v) : val(v) {}
+
+        uint16x8_t val;
+    }; // struct v_uint16x8
+
+    struct v_int16x8
+    {
+        using lane_type = short;
+        enum { nlanes = 8 };
+
+        v_int16x8() = default;
+        explicit v_int16x8(int16x8_t v) : val(v) {}
+
+        int16x8_t val;
+    }; // struct v_int16x8
+
+    struct v_int32x4
+    {
+        using lane_type = int;
+        enum { nlanes = 4 };
+
+        v_int32x4() = default;
+        explicit v_int32x4(int32x4_t v) : val(v) {}
+
+        int32x4_t val;
+    }; // struct v_int32x4
+
+    struct v_float32x4
+    {
+        using lane_type = float32;
+        enum { nlanes = 4 };
+
+        v_float32x4() = default;
+        explicit v_float32x4(float32x4_t v) : val(v) {}
+
+        float32x4_t val;
+    }; // struct v_float32x4
+
+
+    /* ///////////////////////////////////////
+    *  //    NEON load, store and initialization
+    */ //
+    v_uint8x16 inline v_load(const uchar* ptr) { return v_uint8x16(vld1q_u8(ptr)); }
+    v_uint16x8 inline v_load(const ushort* ptr) { return v_uint16x8(vld1q_u16(ptr)); }
+    v_int16x8 inline v_load(const short* ptr) { return v_int16x8(vld1q_s16(ptr)); }
+    v_int32x4 inline v_load(const int* ptr) { return v_int32x4(vld1q_s32(ptr)); }
+    v_float32x4 inline v_load(const float32* ptr) { return v_float32x4(vld1q_f32(ptr)); }
+
+    void inline v_store(uchar* ptr, const v_uint8x16& a) { vst1q_u8(ptr, a.val); }
+    void inline v_store(ushort* ptr, const v_uint16x8& a) { vst1q_u16(ptr, a.val); }
+    void inline v_store(short* ptr, const v_int16x8& a) { vst1q_s16(ptr, a.val); }
+    void inline v_store(int* ptr, const v_int32x4& a) { vst1q_s32(ptr, a.val); }
+    void inline v_store(float32* ptr, const v_float32x4& a) { vst1q_f32(ptr, a.val); }
+
+    v_uint8x16 inline v_setall_u8(uchar v) { return v_uint8x16(vdupq_n_u8(v)); }
+    v_uint16x8 inline v_setall_u16(ushort v) { return v_uint16x8(vdupq_n_u16(v)); }
+    v_int16x8 inline v_setall_s16(short v) { return v_int16x8(vdupq_n_s16(v)); }
+    v_int32x4 inline v_setall_s32(int v) { return v_int32x4(vdupq_n_s32(v)); }
+    v_float32x4 inline v_setall_f32(float32 v) { return v_float32x4(vdupq_n_f32(v)); }
+
+    v_uint8x16 inline v_setzero_u8() { return v_setall_u8(0); }
+    v_uint16x8 inline v_setzero_u16() { return v_setall_u16(0); }
+    v_int16x8 inline v_setzero_s16() { return v_setall_s16(0); }
+    v_int32x4 inline v_setzero_s32() { return v_setall_s32(0); }
+    v_float32x4 inline v_setzero_f32() { return v_setall_f32(0); }
+
+
+    /* ///////////////////////////////////////
+    *  //    NEON arithmetic
+    */ //
+    v_uint8x16 inline operator+(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(vqaddq_u8(a.val, b.val)); }
+    v_uint16x8 inline operator+(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(vqaddq_u16(a.val, b.val)); }
+    v_int16x8 inline operator+(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(vqaddq_s16(a.val, b.val)); }
+    v_int32x4 inline operator+(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(vaddq_s32(a.val, b.val)); }
+    v_float32x4 inline operator+(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(vaddq_f32(a.val, b.val)); }
+
+    v_uint8x16 inline operator-(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(vqsubq_u8(a.val, b.val)); }
+    v_uint16x8 inline operator-(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(vqsubq_u16(a.val, b.val)); }
+    v_int16x8 inline operator-(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(vqsubq_s16(a.val, b.val)); }
+    v_int32x4 inline operator-(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(vsubq_s32(a.val, b.val)); }
+    v_float32x4 inline operator-(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(vsubq_f32(a.val, b.val)); }
+
+    v_int32x4 inline operator*(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(vmulq_s32(a.val, b.val)); }
+    v_float32x4 inline operator*(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(vmulq_f32(a.val, b.val)); }
+    v_float32x4 inline operator/(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(vdivq_f32(a.val, b.val)); }
+
+    v_uint8x16 inline operator&(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(vandq_u8(a.val, b.val)); }
+    v_uint8x16 inline operator|(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(vorrq_u8(a.val, b.val)); }
+    v_uint8x16 inline operator^(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(veorq_u8(a.val, b.val)); }
+
+    v_uint8x16 inline v_min(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(vminq_u8(a.val, b.val)); }
+    v_uint8x16 inline v_max(const v_uint8x16& a, const v_uint8x16& b) { return v_uint8x16(vmaxq_u8(a.val, b.val)); }
+    v_uint16x8 inline v_min(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(vminq_u16(a.val, b.val)); }
+    v_uint16x8 inline v_max(const v_uint16x8& a, const v_uint16x8& b) { return v_uint16x8(vmaxq_u16(a.val, b.val)); }
+    v_int16x8 inline v_min(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(vminq_s16(a.val, b.val)); }
+    v_int16x8 inline v_max(const v_int16x8& a, const v_int16x8& b) { return v_int16x8(vmaxq_s16(a.val, b.val)); }
+    v_int32x4 inline v_min(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(vminq_s32(a.val, b.val)); }
+    v_int32x4 inline v_max(const v_int32x4& a, const v_int32x4& b) { return v_int32x4(vmaxq_s32(a.val, b.val)); }
+    v_float32x4 inline v_min(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(vminq_f32(a.val, b.val)); }
+    v_float32x4 inline v_max(const v_float32x4& a, const v_float32x4& b) { return v_float32x4(vmaxq_f32(a.val, b.val)); }
+
+    template<int n> v_uint16x8 inline v_shl(const v_uint16x8& a) { return v_uint16x8(vshlq_n_u16(a.val, n)); }
+    template<int n> v_int16x8 inline v_shl(const v_int16x8& a) { return v_int16x8(vshlq_n_s16(a.val, n)); }
+    template<int n> v_int32x4 inline v_shl(const v_int32x4& a) { return v_int32x4(vshlq_n_s32(a.val, n)); }
+    template<int n> v_uint16x8 inline v_shr(const v_uint16x8& a) { return v_uint16x8(vshrq_n_u16(a.val, n)); }
+    template<int n> v_int16x8 inline v_shr(const v_int16x8& a) { return v_int16x8(vshrq_n_s16(a.val, n)); }
+    template<int n> v_int32x4 inline v_shr(const v_int32x4& a) { return v_int32x4(vshrq_n_s32(a.val, n)); }
+
+
+    /* ///////////////////////////////////////
+    *  //    NEON widening and narrowing
+    */ //
+    v_uint16x8 inline v_mul_hi(const v_uint16x8& a, const v_uint16x8& b)
+    {
+        const uint32x4_t lo = vmull_u16(vget_low_u16(a.val), vget_low_u16(b.val));
+        const uint32x4_t hi = vmull_u16(vget_high_u16(a.val), vget_high_u16(b.val));
+        return v_uint16x8(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16)));
+    }
+
+    void inline v_mul_expand(const v_int16x8& a, const v_int16x8& b, v_int32x4& c0, v_int32x4& c1)
+    {
+        c0.val = vmull_s16(vget_low_s16(a.val), vget_low_s16(b.val));
+        c1.val = vmull_s16(vget_high_s16(a.val), vget_high_s16(b.val));
+    }
+
+    v_int32x4 inline v_dotprod(const v_int16x8& a, const v_int16x8& b)
+    {
+        v_int32x4 c0, c1;
+        v_mul_expand(a, b, c0, c1);
+        return v_int32x4(vpaddq_s32(c0.val, c1.val));
+    }
+
+    void inline v_expand(const v_uint8x16& a, v_uint16x8& b0, v_uint16x8& b1)
+    {
+        b0.val = vmovl_u8(vget_low_u8(a.val));
+        b1.val = vmovl_u8(vget_high_u8(a.val));
+    }
+
+    void inline v_expand(const v_int16x8& a, v_int32x4& b0, v_int32x4& b1)
+    {
+        b0.val = vmovl_s16(vget_low_s16(a.val));
+        b1.val = vmovl_s16(vget_high_s16(a.val));
+    }
+
+    v_uint8x16 inline v_pack(const v_uint16x8& a, const v_uint16x8& b) { return v_uint8x16(vcombine_u8(vqmovn_u16(a.val), vqmovn_u16(b.val))); }
+    v_uint8x16 inline v_pack_u(const v_int16x8& a, const v_int16x8& b) { return v_uint8x16(vcombine_u8(vqmovun_s16(a.val), vqmovun_s16(b.val))); }
+    v_int16x8 inline v_pack(const v_int32x4& a, const v_int32x4& b) { return v_int16x8(vcombine_s16(vqmovn_s32(a.val), vqmovn_s32(b.val))); }
+    v_uint16x8 inline v_pack_u(const v_int32x4& a, const v_int32x4& b) { return v_uint16x8(vcombine_u16(vqmovun_s32(a.val), vqmovun_s32(b.val))); }
+
+    v_int16x8 inline v_reinterpret_as_s16(const v_uint16x8& a) { return v_int16x8(vreinterpretq_s16_u16(a.val)); }
+    v_uint16x8 inline v_reinterpret_as_u16(const v_int16x8& a) { return v_uint16x8(vreinterpretq_u16_s16(a.val)); }
+
+    v_float32x4 inline v_cvt_f32(const v_int32x4& a) { return v_float32x4(vcvtq_f32_s32(a.val)); }
+    v_int32x4 inline v_round(const v_float32x4& a) { return v_int32x4(vcvtnq_s32_f32(a.val)); }
+
+
+    /* ///////////////////////////////////////
+    *  //    NEON shuffles
+    */ //
+    void inline v_zip(const v_uint8x16& a, const v_uint8x16& b, v_uint8x16& c0, v_uint8x16& c1)
+    {
+        c0.val = vzip1q_u8(a.val, b.val);
+        c1.val = vzip2q_u8(a.val, b.val);
+    }
+
+    void inline v_zip(const v_uint16x8& a, const v_uint16x8& b, v_uint16x8& c0, v_uint16x8& c1)
+    {
+        c0.val = vzip1q_u16(a.val, b.val);
+        c1.val = vzip2q_u16(a.val, b.val);
+    }
+
+    void inline v_zip(const v_int16x8& a, const v_int16x8& b, v_int16x8& c0, v_int16x8& c1)
+    {
+        c0.val = vzip1q_s16(a.val, b.val);
+        c1.val = vzip2q_s16(a.val, b.val);
+    }
+
+    void inline v_zip(const v_int32x4& a, const v_int32x4& b, v_int32x4& c0, v_int32x4& c1)
+    {
+        c0.val = vzip1q_s32(a.val, b.val);
+        c1.val = vzip2q_s32(a.val, b.val);
+    }
+
+    void inline v_zip(const v_float32x4& a, const v_float32x4& b, v_float32x4& c0, v_float32x4& c1)
+    {
+        c0.val = vzip1q_f32(a.val, b.val);
+        c1.val = vzip2q_f32(a.val, b.val);
+    }
+
+    template<int n>
+    v_uint8x16 inline v_extract(const v_uint8x16& a, const v_uint8x16& b)
+    {
+        // Lanes `n` .. `n + 15` of concatenated `a` and `b`, `vextq` takes offsets below 16
+        return n == 16 ? b : v_uint8x16(vextq_u8(a.val, b.val, n & 15));
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    NEON interleaved channels
+    */ //
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b)
+    {
+        const uint8x16x2_t v = vld2q_u8(ptr);
+        a.val = v.val[0];
+        b.val = v.val[1];
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b)
+    {
+        uint8x16x2_t v;
+        v.val[0] = a.val;
+        v.val[1] = b.val;
+        vst2q_u8(ptr, v);
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c)
+    {
+        const uint8x16x3_t v = vld3q_u8(ptr);
+        a.val = v.val[0];
+        b.val = v.val[1];
+        c.val = v.val[2];
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c, v_uint8x16& d)
+    {
+        const uint8x16x4_t v = vld4q_u8(ptr);
+        a.val = v.val[0];
+        b.val = v.val[1];
+        c.val = v.val[2];
+        d.val = v.val[3];
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b, const v_uint8x16& c)
+    {
+        uint8x16x3_t v;
+        v.val[0] = a.val;
+        v.val[1] = b.val;
+        v.val[2] = c.val;
+        vst3q_u8(ptr, v);
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b, const v_uint8x16& c, const v_uint8x16& d)
+    {
+        uint8x16x4_t v;
+        v.val[0] = a.val;
+        v.val[1] = b.val;
+        v.val[2] = c.val;
+        v.val[3] = d.val;
+        vst4q_u8(ptr, v);
+    }
+
+#else
+    /* ///////////////////////////////////////
+    *  //    Scalar registers
+    */ //
+    // Lanes are plain arrays, loops over lanes are left to auto-vectorization of compiler
+    template<typename T, int N>
+    struct v_reg
+    {
+        using lane_type = T;
+        enum { nlanes = N };
+
+        T val[N];
+    }; // struct v_reg
+
+    using v_uint8x16 = v_reg<uchar, 16>;
+    using v_uint16x8 = v_reg<ushort, 8>;
+    using v_int16x8 = v_reg<short, 8>;
+    using v_int32x4 = v_reg<int, 4>;
+    using v_float32x4 = v_reg<float32, 4>;
+
+
+    /* ///////////////////////////////////////
+    *  //    Scalar load, store and initialization
+    */ //
+    template<typename T, int N = 16 / (int)sizeof(T)>
+    v_reg<T, N> inline v_load(const T* ptr)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = ptr[i];
+        return r;
+    }
+
+    template<typename T, int N>
+    void inline v_store(T* ptr, const v_reg<T, N>& a)
+    {
+        for (int i = 0; i < N; ++i)
+            ptr[i] = a.val[i];
+    }
+
+    template<typename T, int N = 16 / (int)sizeof(T)>
+    v_reg<T, N> inline v_setall(T v)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = v;
+        return r;
+    }
+
+    v_uint8x16 inline v_setall_u8(uchar v) { return v_setall<uchar>(v); }
+    v_uint16x8 inline v_setall_u16(ushort v) { return v_setall<ushort>(v); }
+    v_int16x8 inline v_setall_s16(short v) { return v_setall<short>(v); }
+    v_int32x4 inline v_setall_s32(int v) { return v_setall<int>(v); }
+    v_float32x4 inline v_setall_f32(float32 v) { return v_setall<float32>(v); }
+
+    v_uint8x16 inline v_setzero_u8() { return v_setall_u8(0); }
+    v_uint16x8 inline v_setzero_u16() { return v_setall_u16(0); }
+    v_int16x8 inline v_setzero_s16() { return v_setall_s16(0); }
+    v_int32x4 inline v_setzero_s32() { return v_setall_s32(0); }
+    v_float32x4 inline v_setzero_f32() { return v_setall_f32(0); }
+
+
+    /* ///////////////////////////////////////
+    *  //    Scalar arithmetic
+    */ //
+    template<typename T>
+    T inline v_lane_add(T a, T b) { return saturate_cast<T>((int)a + (int)b); }
+    int inline v_lane_add(int a, int b) { return (int)((uint)a + (uint)b); }
+    float32 inline v_lane_add(float32 a, float32 b) { return a + b; }
+
+    template<typename T>
+    T inline v_lane_sub(T a, T b) { return saturate_cast<T>((int)a - (int)b); }
+    int inline v_lane_sub(int a, int b) { return (int)((uint)a - (uint)b); }
+    float32 inline v_lane_sub(float32 a, float32 b) { return a - b; }
+
+    template<typename T, int N>
+    v_reg<T, N> inline operator+(const v_reg<T, N>& a, const v_reg<T, N>& b)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = v_lane_add(a.val[i], b.val[i]);
+        return r;
+    }
+
+    template<typename T, int N>
+    v_reg<T, N> inline operator-(const v_reg<T, N>& a, const v_reg<T, N>& b)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = v_lane_sub(a.val[i], b.val[i]);
+        return r;
+    }
+
+    v_int32x4 inline operator*(const v_int32x4& a, const v_int32x4& b)
+    {
+        v_int32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.val[i] = (int)((uint)a.val[i] * (uint)b.val[i]);
+        return r;
+    }
+
+    v_float32x4 inline operator*(const v_float32x4& a, const v_float32x4& b)
+    {
+        v_float32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.val[i] = a.val[i] * b.val[i];
+        return r;
+    }
+
+    v_float32x4 inline operator/(const v_float32x4& a, const v_float32x4& b)
+    {
+        v_float32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.val[i] = a.val[i] / b.val[i];
+        return r;
+    }
+
+    v_uint8x16 inline operator&(const v_uint8x16& a, const v_uint8x16& b)
+    {
+        v_uint8x16 r;
+        for (int i = 0; i < 16; ++i)
+            r.val[i] = a.val[i] & b.val[i];
+        return r;
+    }
+
+    v_uint8x16 inline operator|(const v_uint8x16& a, const v_uint8x16& b)
+    {
+        v_uint8x16 r;
+        for (int i = 0; i < 16; ++i)
+            r.val[i] = a.val[i] | b.val[i];
+        return r;
+    }
+
+    v_uint8x16 inline operator^(const v_uint8x16& a, const v_uint8x16& b)
+    {
+        v_uint8x16 r;
+        for (int i = 0; i < 16; ++i)
+            r.val[i] = a.val[i] ^ b.val[i];
+        return r;
+    }
+
+    template<typename T, int N>
+    v_reg<T, N> inline v_min(const v_reg<T, N>& a, const v_reg<T, N>& b)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = std::min(a.val[i], b.val[i]);
+        return r;
+    }
+
+    template<typename T, int N>
+    v_reg<T, N> inline v_max(const v_reg<T, N>& a, const v_reg<T, N>& b)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = std::max(a.val[i], b.val[i]);
+        return r;
+    }
+
+    template<int n, typename T, int N>
+    v_reg<T, N> inline v_shl(const v_reg<T, N>& a)
+    {
+        // Shift as unsigned, left shift of negative values is undefined
+        using UT = typename std::make_unsigned<T>::type;
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = (T)((UT)a.val[i] << n);
+        return r;
+    }
+
+    template<int n, typename T, int N>
+    v_reg<T, N> inline v_shr(const v_reg<T, N>& a)
+    {
+        v_reg<T, N> r;
+        for (int i = 0; i < N; ++i)
+            r.val[i] = (T)(a.val[i] >> n);
+        return r;
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    Scalar widening and narrowing
+    */ //
+    v_uint16x8 inline v_mul_hi(const v_uint16x8& a, const v_uint16x8& b)
+    {
+        v_uint16x8 r;
+        for (int i = 0; i < 8; ++i)
+            r.val[i] = (ushort)(((uint)a.val[i] * b.val[i]) >> 16);
+        return r;
+    }
+
+    void inline v_mul_expand(const v_int16x8& a, const v_int16x8& b, v_int32x4& c0, v_int32x4& c1)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            c0.val[i] = (int)a.val[i] * b.val[i];
+            c1.val[i] = (int)a.val[i + 4] * b.val[i + 4];
+        }
+    }
+
+    v_int32x4 inline v_dotprod(const v_int16x8& a, const v_int16x8& b)
+    {
+        // Overflows only for (-32768 * -32768) * 2 as SSE2 and NEON do
+        v_int32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.val[i] = (int)((uint)((int)a.val[i * 2] * b.val[i * 2]) + (uint)((int)a.val[i * 2 + 1] * b.val[i * 2 + 1]));
+        return r;
+    }
+
+    void inline v_expand(const v_uint8x16& a, v_uint16x8& b0, v_uint16x8& b1)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            b0.val[i] = a.val[i];
+            b1.val[i] = a.val[i + 8];
+        }
+    }
+
+    void inline v_expand(const v_int16x8& a, v_int32x4& b0, v_int32x4& b1)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            b0.val[i] = a.val[i];
+            b1.val[i] = a.val[i + 4];
+        }
+    }
+
+    template<typename DT, typename ST, int N>
+    v_reg<DT, N * 2> inline v_pack_lanes(const v_reg<ST, N>& a, const v_reg<ST, N>& b)
+    {
+        v_reg<DT, N * 2> r;
+        for (int i = 0; i < N; ++i)
+        {
+            r.val[i] = saturate_cast<DT>(a.val[i]);
+            r.val[i + N] = saturate_cast<DT>(b.val[i]);
+        }
+        return r;
+    }
+
+    v_uint8x16 inline v_pack(const v_uint16x8& a, const v_uint16x8& b) { return v_pack_lanes<uchar>(a, b); }
+    v_uint8x16 inline v_pack_u(const v_int16x8& a, const v_int16x8& b) { return v_pack_lanes<uchar>(a, b); }
+    v_int16x8 inline v_pack(const v_int32x4& a, const v_int32x4& b) { return v_pack_lanes<short>(a, b); }
+    v_uint16x8 inline v_pack_u(const v_int32x4& a, const v_int32x4& b) { return v_pack_lanes<ushort>(a, b); }
+
+    v_int16x8 inline v_reinterpret_as_s16(const v_uint16x8& a)
+    {
+        v_int16x8 r;
+        memcpy(r.val, a.val, sizeof(r.val));
+        return r;
+    }
+
+    v_uint16x8 inline v_reinterpret_as_u16(const v_int16x8& a)
+    {
+        v_uint16x8 r;
+        memcpy(r.val, a.val, sizeof(r.val));
+        return r;
+    }
+
+    v_float32x4 inline v_cvt_f32(const v_int32x4& a)
+    {
+        v_float32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.val[i] = (float32)a.val[i];
+        return r;
+    }
+
+    v_int32x4 inline v_round(const v_float32x4& a)
+    {
+        v_int32x4 r;
+        for (int i = 0; i < 4; ++i)
+            r.val[i] = lcvRound(a.val[i]);
+        return r;
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    Scalar shuffles
+    */ //
+    template<typename T, int N>
+    void inline v_zip(const v_reg<T, N>& a, const v_reg<T, N>& b, v_reg<T, N>& c0, v_reg<T, N>& c1)
+    {
+        // Read everything first, outputs may alias inputs
+        const v_reg<T, N> x = a, y = b;
+        for (int i = 0; i < N / 2; ++i)
+        {
+            c0.val[i * 2] = x.val[i];
+            c0.val[i * 2 + 1] = y.val[i];
+            c1.val[i * 2] = x.val[i + N / 2];
+            c1.val[i * 2 + 1] = y.val[i + N / 2];
+        }
+    }
+
+    template<int n>
+    v_uint8x16 inline v_extract(const v_uint8x16& a, const v_uint8x16& b)
+    {
+        v_uint8x16 r;
+        for (int i = 0; i < 16; ++i)
+            r.val[i] = i + n < 16 ? a.val[i + n] : b.val[i + n - 16];
+        return r;
+    }
+
+
+    /* ///////////////////////////////////////
+    *  //    Scalar interleaved channels
+    */ //
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            a.val[i] = ptr[i * 2];
+            b.val[i] = ptr[i * 2 + 1];
+        }
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            ptr[i * 2] = a.val[i];
+            ptr[i * 2 + 1] = b.val[i];
+        }
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            a.val[i] = ptr[i * 3];
+            b.val[i] = ptr[i * 3 + 1];
+            c.val[i] = ptr[i * 3 + 2];
+        }
+    }
+
+    void inline v_load_deinterleave(const uchar* ptr, v_uint8x16& a, v_uint8x16& b, v_uint8x16& c, v_uint8x16& d)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            a.val[i] = ptr[i * 4];
+            b.val[i] = ptr[i * 4 + 1];
+            c.val[i] = ptr[i * 4 + 2];
+            d.val[i] = ptr[i * 4 + 3];
+        }
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b, const v_uint8x16& c)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            ptr[i * 3] = a.val[i];
+            ptr[i * 3 + 1] = b.val[i];
+            ptr[i * 3 + 2] = c.val[i];
+        }
+    }
+
+    void inline v_store_interleave(uchar* ptr, const v_uint8x16& a, const v_uint8x16& b, const v_uint8x16& c, const v_uint8x16& d)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            ptr[i * 4] = a.val[i];
+            ptr[i * 4 + 1] = b.val[i];
+            ptr[i * 4 + 2] = c.val[i];
+            ptr[i * 4 + 3] = d.val[i];
+        }
+    }
+#endif // LCV_SSE2
+
+    /* ///////////////////////////////////////
+    *  //    SimdTraits
+    */ //
+    // Register type holding lanes of `T`, for kernels generic over depth
+    template<typename T>
+    struct SimdTraits
+    {
+        enum { enabled = 0 };
+    }; // struct SimdTraits
+
+    template<> struct SimdTraits<uchar> { enum { enabled = 1 }; using vec_type = v_uint8x16; };
+    template<> struct SimdTraits<ushort> { enum { enabled = 1 }; using vec_type = v_uint16x8; };
+    template<> struct SimdTraits<short> { enum { enabled = 1 }; using vec_type = v_int16x8; };
+    template<> struct SimdTraits<int> { enum { enabled = 1 }; using vec_type = v_int32x4; };
+    template<> struct SimdTraits<float32> { enum { enabled = 1 }; using vec_type = v_float32x4; };
+} // namespace lcv
+#endif // LCV_CORE_SIMD_HPP
@@ -0,0 +1,648 @@
+#pragma once
+#ifndef LCV_CORE_TENSOR_HPP
+#define LCV_CORE_TENSOR_HPP
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "lcvdef.hpp"
+#include "lcvtypes.hpp"
+#include "saturate.hpp"
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include "cpu.hpp"
+#include "simd.hpp"
+
+
+namespace lcv
+{
+    enum TensorLayout
+    {
+        LAYOUT_NCHW = 0, // Batch of planar images, sizes are (N, C, H, W)
+        LAYOUT_NHWC = 1  // Batch of interleaved images, sizes are (N, H, W, C)
+    }; // enum TensorLayout
+
+
+    /* ///////////////////////////////////////
+    *  //    Tensor
+    */ //
+    class Tensor
+    {
+    public:
+        const static int MAX_DIMS = 8;
+
+    public:
+        int dims;
+        int sizes[MAX_DIMS];    // Sizes of unused dimensions are 1
+        size_t steps[MAX_DIMS]; // Bytes between neighbours of each dimension, 0 for unused dimensions
+        int layout;             // TensorLayout of a 4D batch, see `image`
+
+        MatrixType type_info;   // Single channel of element depth
+
+        uchar* data;
+
+        // Allocator for `create`, default allocator is used if it is `nullptr`
+        MatrixAllocator* allocator;
+
+    private:
+        MatrixBuffer* buffer; // Shared by all tensors and matrices referring same elements
+
+    private:
+        void incref()
+        {
+            if (buffer != nullptr)
+                buffer->refcount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void decref()
+        {
+            if (buffer != nullptr)
+            {
+                if (buffer->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    MatrixBuffer::release(buffer);
+                buffer = nullptr;
+            }
+        }
+
+        void init()
+        {
+            dims = 0;
+            layout = LAYOUT_NCHW;
+            type_info.packed.value = 0;
+            data = NULL;
+            allocator = nullptr;
+            buffer = nullptr;
+            for (int i = 0; i < MAX_DIMS; ++i)
+            {
+                sizes[i] = 1;
+                steps[i] = 0;
+            }
+        }
+
+        void set_shape(int dims, const int* sizes, int depth)
+        {
+            // Continuous steps, the last dimension is dense
+            assert(dims > 0 && dims <= MAX_DIMS);
+
+            MatrixType mt(depth);
+            mt.packed.fields.channels = 1;
+
+            this->dims = dims;
+            this->type_info = mt;
+            for (int i = 0; i < MAX_DIMS; ++i)
+            {
+                this->sizes[i] = i < dims ? sizes[i] : 1;
+                this->steps[i] = 0;
+            }
+
+            size_t step = elemSize();
+            for (int i = dims - 1; i >= 0; --i)
+            {
+                assert(sizes[i] >= 0);
+                this->steps[i] = step;
+                step *= sizes[i];
+            }
+        }
+
+        void swallow_copy(const Tensor& another)
+        {
+            decref();
+            dims = another.dims;
+            std::copy(another.sizes, another.sizes + MAX_DIMS, sizes);
+            std::copy(another.steps, another.steps + MAX_DIMS, steps);
+            layout = another.layout;
+            type_info = another.type_info;
+            data = another.data;
+            allocator = another.allocator;
+            buffer = another.buffer;
+            incref();
+        }
+
+        void copy_dim(int dim, const uchar* src, uchar* dst, const Tensor& another) const
+        {
+            // Copy elements under `dim` to `another` having same shape
+            const size_t esz = elemSize();
+            if (dim == dims - 1)
+            {
+                if (steps[dim] == esz && another.steps[dim] == esz)
+                    memcpy(dst, src, sizes[dim] * esz);
+                else
+                {
+                    for (int i = 0; i < sizes[dim]; ++i)
+                        memcpy(dst + i * another.steps[dim], src + i * steps[dim], esz);
+                }
+                return;
+            }
+
+            for (int i = 0; i < sizes[dim]; ++i)
+                copy_dim(dim + 1, src + i * steps[dim], dst + i * another.steps[dim], another);
+        }
+
+    public:
+        Tensor() noexcept
+        {
+            init();
+        }
+
+        ~Tensor() noexcept
+        {
+            decref();
+        }
+
+        Tensor(const Tensor& another)
+        {
+            init();
+            swallow_copy(another);
+        }
+
+        Tensor(Tensor&& another) noexcept
+        {
+            init();
+            swap(another);
+        }
+
+        explicit Tensor(int dims, const int* sizes, int depth, int layout = LAYOUT_NCHW)
+        {
+            init();
+            create(dims, sizes, depth, layout);
+        }
+
+        explicit Tensor(const std::vector<int>& sizes, int depth, int layout = LAYOUT_NCHW)
+        {
+            init();
+            create(sizes, depth, layout);
+        }
+
+        Tensor(int dims, const int* sizes, int depth, void* data, const size_t* steps = nullptr)
+        {
+            // Refer external elements without copying, e.g. input buffer of an inference runtime
+            // The elements are not released by tensor and must outlive all tensors referring them
+            // Continuous steps are used if `steps` is `nullptr`
+            init();
+            set_shape(dims, sizes, depth);
+            if (steps != nullptr)
+                std::copy(steps, steps + dims, this->steps);
+            this->data = (uchar*)data;
+        }
+
+        Tensor(int dims, const int* sizes, int depth, void* data, const size_t* steps, const std::function<void(uchar*)>& deleter)
+        {
+            // Refer external elements without copying
+            // `deleter` is called with `data` when the last tensor or matrix referring it is released
+            init();
+            set_shape(dims, sizes, depth);
+            if (steps != nullptr)
+                std::copy(steps, steps + dims, this->steps);
+            this->data = (uchar*)data;
+            this->buffer = deleter ? MatrixBuffer::attach((uchar*)data, deleter) : nullptr;
+        }
+
+        explicit Tensor(const Matrix& m)
+        {
+            // Batch of single image sharing pixels of `m`
+            // PLANAR matrix is LAYOUT_NCHW, interleaved one is LAYOUT_NHWC
+            init();
+            if (m.empty())
+                return;
+
+            const int s[4] = { 1, m.isPlanar() ? m.channels() : m.rows, m.isPlanar() ? m.rows : m.cols, m.isPlanar() ? m.cols : m.channels() };
+            set_shape(4, s, m.depth());
+
+            const size_t esz = m.elemSize1();
+            if (m.isPlanar())
+            {
+                steps[1] = m.step_info.planestep;
+                steps[2] = m.step_info.linestep;
+                steps[3] = esz;
+                layout = LAYOUT_NCHW;
+            }
+            else
+            {
+                steps[1] = m.step_info.linestep;
+                steps[2] = m.elemSize();
+                steps[3] = esz;
+                layout = LAYOUT_NHWC;
+            }
+            steps[0] = steps[1] * s[1];
+
+            data = m.data;
+            buffer = m.buffer;
+            incref();
+        }
+
+    public:
+        Tensor& operator=(const Tensor& another)
+        {
+            if (this != &another)
+                swallow_copy(another);
+            return *this;
+        }
+
+        Tensor& operator=(Tensor&& another) noexcept
+        {
+            if (this != &another)
+            {
+                Tensor t(std::move(another));
+                swap(t);
+            }
+            return *this;
+        }
+
+    public:
+        static Tensor batch(int n, int cols, int rows, int channels, int depth, int layout = LAYOUT_NCHW)
+        {
+            // One continuous allocation for `n` images
+            Tensor t;
+            t.createBatch(n, cols, rows, channels, depth, layout);
+            return t;
+        }
+
+        static Tensor zeros(const std::vector<int>& sizes, int depth, int layout = LAYOUT_NCHW)
+        {
+            Tensor t(sizes, depth, layout);
+            memset(t.data, 0, t.total() * t.elemSize());
+            return t;
+        }
+
+    public:
+        void create(int dims, const int* sizes, int depth, int layout = LAYOUT_NCHW)
+        {
+            // Keep current elements when shape and depth are same, e.g. batch of previous frames
+            MatrixType mt(depth);
+            mt.packed.fields.channels = 1;
+            if (data != NULL && isContinuous() && this->dims == dims &&
+                type_info.packed.value == mt.packed.value && std::equal(sizes, sizes + dims, this->sizes))
+            {
+                this->layout = layout;
+                return;
+            }
+
+            Tensor t;
+            t.set_shape(dims, sizes, depth);
+            t.layout = layout;
+            t.allocator = allocator;
+            t.buffer = MatrixBuffer::allocate(allocator != nullptr ? allocator : MatrixAllocator::getDefault(), t.total() * t.elemSize());
+            t.data = t.buffer->data();
+            swap(t);
+        }
+
+        void create(const std::vector<int>& sizes, int depth, int layout = LAYOUT_NCHW)
+        {
+            create((int)sizes.size(), sizes.data(), depth, layout);
+        }
+
+        void createBatch(int n, int cols, int rows, int channels, int depth, int layout = LAYOUT_NCHW)
+        {
+            const int s[4] = { n, layout == LAYOUT_NCHW ? channels : rows, layout == LAYOUT_NCHW ? rows : cols, layout == LAYOUT_NCHW ? cols : channels };
+            create(4, s, depth, layout);
+        }
+
+        Tensor reshape(int dims, const int* sizes) const
+        {
+            // View of same elements in other shape, only for continuous tensor
+            assert(isContinuous());
+
+            Tensor t(*this);
+            t.set_shape(dims, sizes, depth());
+            assert(t.total() == total());
+            return t;
+        }
+
+        Tensor reshape(const std::vector<int>& sizes) const
+        {
+            return reshape((int)sizes.size(), sizes.data());
+        }
+
+        Matrix image(int n) const
+        {
+            // View of image `n` of 4D batch sharing elements, PLANAR matrix for LAYOUT_NCHW
+            assert(dims == 4 && n >= 0 && n < sizes[0]);
+
+            const bool planar = layout == LAYOUT_NCHW;
+            const int channels = planar ? sizes[1] : sizes[3];
+            const int rows = planar ? sizes[2] : sizes[1];
+            const int cols = planar ? sizes[3] : sizes[2];
+
+            // Elements of scanline are dense, interleaved channels too
+            assert(steps[3] == elemSize() && (planar || steps[2] == elemSize() * channels));
+
+            MatrixType mt(type_info);
+            mt.packed.fields.channels = channels;
+            assert(mt.channels() == channels && "Too many channels for matrix");
+
+            Matrix m;
+            m.attach(cols, rows, mt, data + n * steps[0], planar ? steps[2] : steps[1], buffer, planar ? steps[1] : 0);
+            m.incref();
+            return m;
+        }
+
+        void copyTo(Tensor& tensor) const
+        {
+            // `tensor` gets continuous copy, its elements are reused when it has same shape and depth
+            Tensor output = buffer != nullptr && tensor.buffer == buffer ? Tensor() : tensor;
+            output.create(dims, sizes, depth(), layout);
+            if (isContinuous())
+                memcpy(output.data, data, total() * elemSize());
+            else if (dims > 0)
+                copy_dim(0, data, output.data, output);
+            tensor = std::move(output);
+        }
+
+        Tensor clone() const
+        {
+            Tensor t;
+            copyTo(t);
+            return t;
+        }
+
+        void swap(Tensor& another) noexcept
+        {
+            // Exchange headers only
+            std::swap(dims, another.dims);
+            std::swap(sizes, another.sizes);
+            std::swap(steps, another.steps);
+            std::swap(layout, another.layout);
+            std::swap(type_info.packed.value, another.type_info.packed.value);
+            std::swap(data, another.data);
+            std::swap(allocator, another.allocator);
+            std::swap(buffer, another.buffer);
+        }
+
+    public:
+        bool empty() const
+        {
+            return data == NULL;
+        }
+
+        size_t total() const
+        {
+            // A number of elements
+            size_t n = dims > 0 ? 1 : 0;
+            for (int i = 0; i < dims; ++i)
+                n *= sizes[i];
+            return n;
+        }
+
+        size_t elemSize() const
+        {
+            return (size_t)type_info.bbp() / 8;
+        }
+
+        int depth() const
+        {
+            return type_info.depth();
+        }
+
+        int type() const
+        {
+            return type_info.depth();
+        }
+
+        std::vector<int> shape() const
+        {
+            return std::vector<int>(sizes, sizes + dims);
+        }
+
+        bool isContinuous() const
+        {
+            // Elements follow each other without gaps
+            size_t step = elemSize();
+            for (int i = dims - 1; i >= 0; --i)
+            {
+                if (sizes[i] > 1 && steps[i] != step)
+                    return false;
+                step *= sizes[i];
+            }
+            return true;
+        }
+
+    public:
+        uchar* ptr(int i0 = 0, int i1 = 0, int i2 = 0, int i3 = 0)
+        {
+            // Steps of unused dimensions are zero
+            return data + i0 * steps[0] + i1 * steps[1] + i2 * steps[2] + i3 * steps[3];
+        }
+
+        const uchar* ptr(int i0 = 0, int i1 = 0, int i2 = 0, int i3 = 0) const
+        {
+            return data + i0 * steps[0] + i1 * steps[1] + i2 * steps[2] + i3 * steps[3];
+        }
+
+        uchar* ptr(const int* idx)
+        {
+            uchar* p = data;
+            for (int i = 0; i < dims; ++i)
+                p += idx[i] * steps[i];
+            return p;
+        }
+
+        const uchar* ptr(const int* idx) const
+        {
+            const uchar* p = data;
+            for (int i = 0; i < dims; ++i)
+                p += idx[i] * steps[i];
+            return p;
+        }
+
+        template<typename Element>
+        Element* ptr(int i0 = 0, int i1 = 0, int i2 = 0, int i3 = 0)
+        {
+            return (Element*)ptr(i0, i1, i2, i3);
+        }
+
+        template<typename Element>
+        const Element* ptr(int i0 = 0, int i1 = 0, int i2 = 0, int i3 = 0) const
+        {
+            return (const Element*)ptr(i0, i1, i2, i3);
+        }
+    }; // class Tensor
+
+
+    /* ///////////////////////////////////////
+    *  //    blobFromImages
+    */ //
+    template<typename ST, typename DT>
+    struct BlobRow
+    {
+        template<typename WT>
+        static int simd(const ST* /*src*/, DT* const* /*dst*/, int /*width*/, int /*cn*/, const int* /*from*/, const WT* /*mean*/, WT /*scale*/)
+        {
+            return 0;
+        }
+    }; // struct BlobRow
+
+    template<>
+    struct BlobRow<uchar, float32>
+    {
+        static void store(float32* dst, const v_uint8x16& v, const v_float32x4& mean, const v_float32x4& scale)
+        {
+            v_uint16x8 w0, w1;
+            v_expand(v, w0, w1);
+
+            v_int32x4 a0, a1, a2, a3;
+            v_expand(v_reinterpret_as_s16(w0), a0, a1);
+            v_expand(v_reinterpret_as_s16(w1), a2, a3);
+
+            v_store(dst, (v_cvt_f32(a0) - mean) * scale);
+            v_store(dst + 4, (v_cvt_f32(a1) - mean) * scale);
+            v_store(dst + 8, (v_cvt_f32(a2) - mean) * scale);
+            v_store(dst + 12, (v_cvt_f32(a3) - mean) * scale);
+        }
+
+        static int simd(const uchar* src, float32* const* dst, int width, int cn, const int* from, const float32* mean, float32 scale)
+        {
+            // Returns pixels processed, channels are deinterleaved into planes
+            if (cn > 4)
+                return 0;
+
+            const int lanes = v_uint8x16::nlanes;
+            const v_float32x4 vscale = v_setall_f32(scale);
+            v_float32x4 vmean[4];
+            for (int c = 0; c < cn; ++c)
+                vmean[c] = v_setall_f32(mean[c]);
+
+            int x = 0;
+            for (; x <= width - lanes; x += lanes)
+            {
+                v_uint8x16 v[4];
+                if (cn == 1)
+                    v[0] = v_load(src + x);
+                else if (cn == 2)
+                    v_load_deinterleave(src + x * 2, v[0], v[1]);
+                else if (cn == 3)
+                    v_load_deinterleave(src + x * 3, v[0], v[1], v[2]);
+                else
+                    v_load_deinterleave(src + x * 4, v[0], v[1], v[2], v[3]);
+
+                for (int c = 0; c < cn; ++c)
+                    store(dst[c] + x, v[from[c]], vmean[c], vscale);
+            }
+            return x;
+        }
+    }; // struct BlobRow
+
+    template<typename ST, typename DT, typename WT>
+    void blob_row(const ST* src, DT* const* dst, int dst_stride, int width, int cn, const int* from, const WT* mean, WT scale)
+    {
+        // Channel `c` of destination is `(src[from[c]] - mean[c]) * scale`
+        // Planes are dense, interleaved destination has `dst_stride` of channels
+        const int x = dst_stride == 1 ? BlobRow<ST, DT>::simd(src, dst, simd_width(width), cn, from, mean, scale) : 0;
+        for (int c = 0; c < cn; ++c)
+        {
+            const ST* s = src + from[c];
+            DT* d = dst[c];
+            for (int i = x; i < width; ++i)
+                d[i * dst_stride] = saturate_cast<DT>(((WT)s[i * cn] - mean[c]) * scale);
+        }
+    } // blob_row
+
+    template<typename ST, typename DT>
+    void blob_from_images(const std::vector<Matrix>& images, const Tensor& blob, double scalefactor, const Scalar& mean, bool swapRB)
+    {
+        // 8/16-bits integers and float32 are exact in float32, others need float64
+        using WT = typename std::conditional<sizeof(ST) <= 2 || std::is_same<ST, float32>::value, float32, float64>::type;
+
+        const int n = (int)images.size();
+        const int cn = images[0].channels();
+        const int rows = images[0].rows, cols = images[0].cols;
+
+        // Red and blue are exchanged by reading channels in other order
+        int from[4] = { 0, 1, 2, 3 };
+        if (swapRB && cn >= 3)
+            std::swap(from[0], from[2]);
+
+        WT wmean[4];
+        for (int c = 0; c < cn; ++c)
+            wmean[c] = (WT)mean[c];
+
+        std::vector<Matrix> slots(n);
+        for (int i = 0; i < n; ++i)
+            slots[i] = blob.image(i);
+
+        parallel_for_(Range(0, n * rows), [&](const Range& range)
+        {
+            cpu_dispatch([&]()
+            {
+                for (int r = range.start; r < range.end; ++r)
+                {
+                    const int i = r / rows, y = r % rows;
+                    const Matrix& slot = slots[i];
+
+                    DT* dst[4];
+                    int dst_stride = 1;
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        if (slot.isPlanar())
+                            dst[c] = (DT*)(slot.ptr(y) + c * slot.step_info.planestep);
+                        else
+                        {
+                            dst[c] = (DT*)slot.ptr(y) + c;
+                            dst_stride = cn;
+                        }
+                    }
+
+                    blob_row<ST, DT, WT>(images[i].ptr<ST>(y), dst, dst_stride, cols, cn, from, wmean, (WT)scalefactor);
+                }
+            });
+        }, parallel_grain((int64)cols * cn));
+    } // blob_from_images
+
+    template<typename ST>
+    void blob_from_images(const std::vector<Matrix>& images, const Tensor& blob, double scalefactor, const Scalar& mean, bool swapRB)
+    {
+        if (blob.depth() == LCV_32F)
+            blob_from_images<ST, float32>(images, blob, scalefactor, mean, swapRB);
+        else if (blob.depth() == LCV_8U)
+            blob_from_images<ST, uchar>(images, blob, scalefactor, mean, swapRB);
+        else
+            assert(0 && "Unsupported depth");
+    } // blob_from_images
+
+    void blobFromImages(const std::vector<Matrix>& images, Tensor& blob, double scalefactor = 1.0, const Scalar& mean = Scalar(),
+        bool swapRB = false, int ddepth = LCV_32F, int layout = LAYOUT_NCHW)
+    {
+        // Preprocess images of same size and type into 4D batch as `(image - mean) * scalefactor`
+        // Each image is written once into its place of the batch, `blob` is reused when it has same shape
+        // Only support up to 4 interleaved channels, `ddepth` is LCV_32F or LCV_8U
+        assert(!images.empty());
+        const Matrix& first = images[0];
+        for (const Matrix& image : images)
+        {
+            assert(image.cols == first.cols && image.rows == first.rows && image.type() == first.type());
+            assert(!image.isPlanar() && image.channels() <= 4);
+        }
+
+        blob.createBatch((int)images.size(), first.cols, first.rows, first.channels(), ddepth, layout);
+
+        const int sdepth = first.depth();
+        if (sdepth == LCV_8U)
+            blob_from_images<uchar>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_8S)
+            blob_from_images<schar>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_16U)
+            blob_from_images<ushort>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_16S)
+            blob_from_images<short>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_32U)
+            blob_from_images<uint>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_32S)
+            blob_from_images<int>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_32F)
+            blob_from_images<float32>(images, blob, scalefactor, mean, swapRB);
+        else if (sdepth == LCV_64F)
+            blob_from_images<float64>(images, blob, scalefactor, mean, swapRB);
+        else
+            assert(0 && "Unsupported depth");
+    } // blobFromImages
+
+    Tensor inline blobFromImage(const Matrix& image, double scalefactor = 1.0, const Scalar& mean = Scalar(),
+        bool swapRB = false, int ddepth = LCV_32F, int layout = LAYOUT_NCHW)
+    {
+        Tensor blob;
+        blobFromImages(std::vector<Matrix>(1, image), blob, scalefactor, mean, swapRB, ddepth, layout);
+        return blob;
+    } // blobFromImage
+} // namespace lcv
+#endif // LCV_CORE_TENSOR_HPP
@@ -22,6 +22,9 @@ namespace lcv
     private:
         DIB(const Matrix& mat)
         {
+            // DIB stores interleaved pixels only
+            assert(!mat.isPlanar());
+
             int bpp, width, height;
             bpp = mat.elemSize() * 8;
             width = (mat.cols % 2) ? (mat.cols + 1) : mat.cols; // SetDIBitsToDevice requires DWORD aligned
@@ -29,24 +32,22 @@ namespace lcv
 
             create(bpp, width, height);
 
-            Matrix m;
-            mat.copyTo(m);
-
-            if (width != mat.cols)
+            const int stride = width * ((int)bpp / 8);
+            const int scanline_bytes = mat.cols * ((int)bpp / 8);
+            if (mat.cols == width && (size_t)stride == mat.step_info.linestep)
+            {
+                // scanlines of matrix are same as DIB's, odd width of ROI would read pixels of the next scanline
+                memcpy(pdata, mat.ptr(), stride * height);
+            }
+            else
             {
-                // stride was not aligned by default
+                // stride was not aligned by default or matrix has padded scanlines
                 for (int y = 0; y < height; ++y)
                 {
                     // copy pixels stride by stride
-                    const int offset = width * ((int)bpp / 8);
-                    memcpy(&pdata[offset * y], m.ptr(y), offset);
+                    memcpy(&pdata[stride * y], mat.ptr(y), scanline_bytes);
                 }
             }
-            else
-            {
-                // stride was aligned by default
-                memcpy(pdata, m.data, width * height * ((int)bpp / 8));
-            }
         }
         
     public:
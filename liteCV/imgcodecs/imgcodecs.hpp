@@ -39,6 +39,22 @@ namespace fs = std::experimental::filesystem;
 
 namespace lcv
 {
+    void copy_to_packed(const Matrix& img, Matrix& packed)
+    {
+        // Encoders except png cannot take a stride
+        const size_t scanline_bytes = (size_t)img.cols * img.elemSize();
+        if ((size_t)img.step_info.linestep == scanline_bytes)
+        {
+            packed = img;
+        }
+        else
+        {
+            packed.create(img.cols, img.rows, img.type());
+            for (int y = 0; y < img.rows; ++y)
+                memcpy(packed.ptr(y), img.ptr(y), scanline_bytes);
+        }
+    } // copy_to_packed
+
     Matrix imread(const std::string& filename, int flag = IMREAD_UNCHANGED)
     {
         Matrix img;
@@ -69,10 +85,9 @@ namespace lcv
         if (data == NULL)
             goto ret;
 
-        // Copy from buffer
-        img.create(width, height, req_comp == 0 ? channels : req_comp, LCV_8U);
-        memcpy(img.ptr(), data, (size_t)height * img.step_info.linestep);
-        stbi_image_free(data);
+        // Refer decoded buffer without copying, it is released by stb_image with the last reference
+        img = Matrix(width, height, MatrixType(8, req_comp == 0 ? channels : req_comp, MatrixType::UNSIGNED_INTEGER_NUMBER).packed.value,
+            data, Matrix::AUTO_STEP, [](uchar* p) { stbi_image_free(p); });
 
         // Change pixel order
         if (img.channels() == 3)
@@ -86,8 +101,9 @@ namespace lcv
 
     bool imwrite(const std::string& filename, const Matrix& img, const std::vector<int>& params = std::vector<int>())
     {
-        // Only write grayscale or color (3ch/4ch) image
+        // Only write grayscale or color (3ch/4ch) image of interleaved pixels
         assert(img.channels() == 1 || img.channels() == 3 || img.channels() == 4);
+        assert(!img.isPlanar());
 
         Matrix _img;
 
@@ -99,10 +115,13 @@ namespace lcv
         std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
 
         // Change pixel order
+        // Grayscale image is used as it is unless it has padded scanlines
         if (img.channels() == 3)
             cvtColor(img, _img, COLOR_RGB2BGR);
         else if (img.channels() == 4)
             cvtColor(img, _img, COLOR_BGRA2RGBA);
+        else
+            copy_to_packed(img, _img);
 
         // Write image to file to use proper image encoder by the extension
         // `params` is not used yet :(
@@ -153,10 +172,9 @@ namespace lcv
         if (data == NULL)
             goto ret;
 
-        // Copy from buffer
-        img.create(width, height, req_comp == 0 ? channels : req_comp, LCV_8U);
-        memcpy(img.ptr(), data, (size_t)height * img.step_info.linestep);
-        stbi_image_free(data);
+        // Refer decoded buffer without copying, it is released by stb_image with the last reference
+        img = Matrix(width, height, MatrixType(8, req_comp == 0 ? channels : req_comp, MatrixType::UNSIGNED_INTEGER_NUMBER).packed.value,
+            data, Matrix::AUTO_STEP, [](uchar* p) { stbi_image_free(p); });
 
         // Change pixel order to save as RGB or RGBA
         if (img.channels() == 3)
@@ -170,8 +188,9 @@ namespace lcv
 
     bool imencode(const std::string& ext, const Matrix& img, std::vector<uchar>& buf, const std::vector<int>& params = std::vector<int>())
     {
-        // Only encode grayscale or color (3ch/4ch) image
+        // Only encode grayscale or color (3ch/4ch) image of interleaved pixels
         assert(img.channels() == 1 || img.channels() == 3 || img.channels() == 4);
+        assert(!img.isPlanar());
 
         std::vector<uchar> encoded_buffer;
         Matrix _img;
@@ -191,10 +210,13 @@ namespace lcv
         encoded_buffer.reserve((size_t)img.cols * img.rows * img.elemSize());
 
         // Change pixel order to save as RGB or RGBA
+        // Grayscale image is used as it is unless it has padded scanlines
         if (img.channels() == 3)
             cvtColor(img, _img, COLOR_RGB2BGR);
         else if (img.channels() == 4)
             cvtColor(img, _img, COLOR_BGRA2RGBA);
+        else
+            copy_to_packed(img, _img);
 
         // Encode image to buffer to use proper image encoder by the extension
         // `params` is not used yet :(
@@ -220,7 +242,7 @@ namespace lcv
         // When succeed
         success_ret:
         encoded_buffer.shrink_to_fit();
-        buf = encoded_buffer;
+        buf = std::move(encoded_buffer);
         return true;
     } // imencode
 } // namespace lcv
@@ -2,7 +2,15 @@
 #ifndef LCV_IMGPROC_BORDER_HPP
 #define LCV_IMGPROC_BORDER_HPP
 #include "liteCV/core/lcvdef.hpp"
+#include "liteCV/core/lcvtypes.hpp"
+#include "liteCV/core/saturate.hpp"
+#include "liteCV/core/matrix.hpp"
+#include "liteCV/core/parallel.hpp"
+#include <vector>
+#include <cstring>
 #include <utility>
+#include <stdexcept>
+#include <algorithm>
 
 
 namespace lcv
@@ -14,109 +22,243 @@ namespace lcv
         BORDER_REFLECT,
         BORDER_REFLECT_101,
         BORDER_DEFAULT = BORDER_REFLECT_101,
+        BORDER_ISOLATED = 16, // Flag not to read pixels of the parent around ROI
     }; // enum BorderTypes
 
-    class BorderPolicy
-    {
-    public:
-        virtual bool is_constant() const = 0;
-        virtual int calculate(int p, int max_boundary) = 0;
-    }; // class BorderPolicy
 
-    class ConstantBorderPolicy : public BorderPolicy
+    /* ///////////////////////////////////////
+    *  //    Border policies
+    */ //
+    // `calculate(p, len)` maps coordinate `p` out of `[0, len)` into it, `-1` means the constant border value
+    // Policies are template parameters of border-aware kernels, see `with_border_policy`
+    struct ConstantBorderPolicy
     {
-    public:
-        bool is_constant() const final
-        {
-            return true;
-        }
+        enum { constant = 1 };
 
-        int calculate(int p, int max_boundary) final
+        static int calculate(int p, int len)
         {
-            return p;
+            return (p >= 0 && p < len) ? p : -1;
         }
-    }; // class ConstantBorderPolicy
+    }; // struct ConstantBorderPolicy
 
-    class ReplicateBorderPolicy : public BorderPolicy
+    struct ReplicateBorderPolicy
     {
-    public:
-        bool is_constant() const final
+        enum { constant = 0 };
+
+        static int calculate(int p, int len)
         {
-            return false;
+            return std::max<int>(std::min<int>(p, len - 1), 0);
         }
+    }; // struct ReplicateBorderPolicy
 
-        int calculate(int p, int max_boundary) final
+    struct ReflectBorderPolicy
+    {
+        enum { constant = 0 };
+
+        static int calculate(int p, int len)
         {
-            return std::max<int>(std::min<int>(p, max_boundary - 1), 0);
+            // Reflected again while out of range, margins can be wider than `len`
+            while ((unsigned)p >= (unsigned)len)
+                p = p < 0 ? -p - 1 : len - (p - len) - 1;
+            return p;
         }
-    }; // class ReplicateBorderPolicy
+    }; // struct ReflectBorderPolicy
 
-    class ReflectBorderPolicy : public BorderPolicy
+    struct Reflect101BorderPolicy
     {
-    public:
-        bool is_constant() const final
+        enum { constant = 0 };
+
+        static int calculate(int p, int len)
         {
-            return false;
+            // Single pixel has no pixel to reflect around it
+            if (len == 1)
+                return 0;
+
+            while ((unsigned)p >= (unsigned)len)
+                p = p < 0 ? -p : len - (p - len) - 2;
+            return p;
         }
+    }; // struct Reflect101BorderPolicy
 
-        int calculate(int p, int max_boundary) final
+    template<template<typename> class Op, typename... Args>
+    void with_border_policy(int borderType, Args&&... args)
+    {
+        // Run `Op<Policy>::run(args...)` with the policy of `borderType` chosen once per call
+        switch (borderType)
         {
-            if (p < 0)
-                return std::min<int>(-p - 1, max_boundary - 1);
-            else if (p >= max_boundary)
-                return std::max<int>(max_boundary - (p - max_boundary) - 1, 0);
-            return p;
+        case BORDER_CONSTANT:
+            Op<ConstantBorderPolicy>::run(std::forward<Args>(args)...);
+            return;
+
+        case BORDER_REPLICATE:
+            Op<ReplicateBorderPolicy>::run(std::forward<Args>(args)...);
+            return;
+
+        case BORDER_REFLECT:
+            Op<ReflectBorderPolicy>::run(std::forward<Args>(args)...);
+            return;
+
+        case BORDER_REFLECT_101:
+            Op<Reflect101BorderPolicy>::run(std::forward<Args>(args)...);
+            return;
         }
-    }; // class ReflectBorderPolicy
 
-    class Reflect101BorderPolicy : public BorderPolicy
+        throw std::invalid_argument("Unsupported border type");
+    } // with_border_policy
+
+    int inline borderInterpolate(int p, int len, int borderType)
     {
-    public:
-        bool is_constant() const final
+        // Source coordinate of `p` for single lookups, `-1` for constant border
+        switch (borderType)
         {
-            return false;
+        case BORDER_CONSTANT:
+            return ConstantBorderPolicy::calculate(p, len);
+
+        case BORDER_REPLICATE:
+            return ReplicateBorderPolicy::calculate(p, len);
+
+        case BORDER_REFLECT:
+            return ReflectBorderPolicy::calculate(p, len);
+
+        case BORDER_REFLECT_101:
+            return Reflect101BorderPolicy::calculate(p, len);
         }
 
-        int calculate(int p, int max_boundary) final
+        throw std::invalid_argument("Unsupported border type");
+    } // borderInterpolate
+
+    Matrix inline border_source(const Matrix& src, int top, int bottom, int left, int right, int borderType, Rect& roi)
+    {
+        // Pixels readable around `src` up to the margins, ROI extends into its parent unless BORDER_ISOLATED
+        // Border policies apply to the sides of the returned view, `roi` is `src` in it
+        Matrix view = src;
+        if (borderType & BORDER_ISOLATED)
         {
-            if (p < 0)
-                return std::min<int>(-p, max_boundary - 1);
-            else if (p >= max_boundary)
-                return std::max<int>(max_boundary - (p - max_boundary) - 2, 0);
-            return p;
+            roi = Rect(0, 0, src.cols, src.rows);
+            return view;
         }
-    }; // class Reflect101BorderPolicy
 
-    class BorderPolicyStorage
+        Size wholeSize;
+        Point ofs;
+        src.locateROI(wholeSize, ofs);
+
+        const int dtop = std::min(std::max(top, 0), ofs.y);
+        const int dbottom = std::min(std::max(bottom, 0), wholeSize.height - ofs.y - src.rows);
+        const int dleft = std::min(std::max(left, 0), ofs.x);
+        const int dright = std::min(std::max(right, 0), wholeSize.width - ofs.x - src.cols);
+        view.adjustROI(dtop, dbottom, dleft, dright);
+        roi = Rect(dleft, dtop, src.cols, src.rows);
+        return view;
+    } // border_source
+
+    Matrix inline border_source(const Matrix& src, int borderType, Rect& roi)
     {
-    private:
-        BorderPolicyStorage() = delete;
+        // Whole parent of ROI unless BORDER_ISOLATED, so border policies apply to sides of the parent
+        Size wholeSize;
+        Point ofs;
+        src.locateROI(wholeSize, ofs);
+        return border_source(src, ofs.y, wholeSize.height - ofs.y - src.rows, ofs.x, wholeSize.width - ofs.x - src.cols, borderType, roi);
+    } // border_source
 
-    public:
-        static BorderPolicy* get_policy(int type = BORDER_DEFAULT)
-        {
-            static ConstantBorderPolicy cbp;
-            static ReplicateBorderPolicy repbp;
-            static ReflectBorderPolicy refbp;
-            static Reflect101BorderPolicy ref101bp;
 
-            switch (type)
-            {
-            case BORDER_CONSTANT:
-                return static_cast<BorderPolicy*>(&cbp);
+    /* ///////////////////////////////////////
+    *  //    copyMakeBorder
+    */ //
+    template<typename Type>
+    void scalar_to_pixel(const Scalar& value, int first_channel, int channels, uchar* pixel)
+    {
+        // Channel `first_channel + ch` of `value` for channel `ch` of pixel
+        for (int ch = 0; ch < channels; ++ch)
+            ((Type*)pixel)[ch] = saturate_cast<Type>(value[(first_channel + ch) % 4]);
+    } // scalar_to_pixel
 
-            case BORDER_REPLICATE:
-                return static_cast<BorderPolicy*>(&repbp);
+    void inline scalar_to_pixel(const Scalar& value, int depth, int first_channel, int channels, uchar* pixel)
+    {
+        if (depth == LCV_8U)
+            scalar_to_pixel<uchar>(value, first_channel, channels, pixel);
+        else if (depth == LCV_8S)
+            scalar_to_pixel<schar>(value, first_channel, channels, pixel);
+        else if (depth == LCV_16U)
+            scalar_to_pixel<ushort>(value, first_channel, channels, pixel);
+        else if (depth == LCV_16S)
+            scalar_to_pixel<short>(value, first_channel, channels, pixel);
+        else if (depth == LCV_32U)
+            scalar_to_pixel<uint>(value, first_channel, channels, pixel);
+        else if (depth == LCV_32S)
+            scalar_to_pixel<int>(value, first_channel, channels, pixel);
+        else if (depth == LCV_32F)
+            scalar_to_pixel<float32>(value, first_channel, channels, pixel);
+        else if (depth == LCV_64F)
+            scalar_to_pixel<float64>(value, first_channel, channels, pixel);
+        else
+            assert(0 && "Unsupported depth");
+    } // scalar_to_pixel
 
-            case BORDER_REFLECT:
-                return static_cast<BorderPolicy*>(&refbp);
+    void copyMakeBorder(const Matrix& src, Matrix& dst, int top, int bottom, int left, int right, int borderType, const Scalar& value = Scalar())
+    {
+        // Copy `src` into the middle of `dst` and fill margins by `borderType`, constant border is `value`
+        // Margins of ROI take pixels of its parent where they exist unless BORDER_ISOLATED
+        assert(!src.empty() && top >= 0 && bottom >= 0 && left >= 0 && right >= 0);
+
+        Rect roi;
+        const Matrix source = border_source(src, top, bottom, left, right, borderType, roi);
+        borderType &= ~BORDER_ISOLATED;
+
+        // `dst` can be a view of the parent of `src`, then a new buffer is used
+        const int cols = src.cols + left + right, rows = src.rows + top + bottom;
+        Matrix output = source.overlaps(dst) ? Matrix() : dst;
+        if (src.isPlanar())
+            output.createPlanar(cols, rows, src.type());
+        else
+            output.create(cols, rows, src.type());
 
-            case BORDER_REFLECT_101:
-                return static_cast<BorderPolicy*>(&ref101bp);
-            }
+        // Pixel `x` of output is pixel `xmap[x]` of source scanline, `-1` for constant border
+        // Pixels of source scanline are a single run
+        const int shift_x = roi.x - left, shift_y = roi.y - top;
+        std::vector<int> xmap(cols);
+        for (int x = 0; x < cols; ++x)
+            xmap[x] = borderInterpolate(x + shift_x, source.cols, borderType);
+        const int inner_start = std::min(std::max(0, -shift_x), cols);
+        const int inner_end = std::max(std::min(cols, source.cols - shift_x), inner_start);
+
+        // Planes of PLANAR matrix are single channel images
+        const int channels = src.isPlanar() ? 1 : src.channels();
+        const size_t pixel_bytes = source.step_info.pixelstep;
+        std::vector<uchar> constant(pixel_bytes);
+        for (int p = 0; p < src.planes(); ++p)
+        {
+            scalar_to_pixel(value, src.depth(), p, channels, constant.data());
 
-            return nullptr;
+            parallel_for_(Range(0, rows), [&](const Range& range)
+            {
+                for (int y = range.start; y < range.end; ++y)
+                {
+                    const int sy = borderInterpolate(y + shift_y, source.rows, borderType);
+                    const uchar* scanline = sy < 0 ? NULL : source.ptr(sy) + p * source.step_info.planestep;
+                    uchar* out = output.ptr(y) + p * output.step_info.planestep;
+                    auto fill_border = [&](int start, int end)
+                    {
+                        for (int x = start; x < end; ++x)
+                        {
+                            const uchar* pixel = (scanline == NULL || xmap[x] < 0) ? constant.data() : scanline + xmap[x] * pixel_bytes;
+                            memcpy(out + x * pixel_bytes, pixel, pixel_bytes);
+                        }
+                    };
+
+                    if (scanline == NULL)
+                    {
+                        fill_border(0, cols);
+                        continue;
+                    }
+
+                    fill_border(0, inner_start);
+                    memcpy(out + inner_start * pixel_bytes, scanline + (inner_start + shift_x) * pixel_bytes, (inner_end - inner_start) * pixel_bytes);
+                    fill_border(inner_end, cols);
+                }
+            }, parallel_grain((int64)cols * pixel_bytes));
         }
-    }; // class BorderPolicyStorage
+
+        dst = std::move(output);
+    } // copyMakeBorder
 } // namespace lcv
 #endif // LCV_IMGPROC_BORDER_HPP
@@ -3,6 +3,8 @@
 #define LCV_IMGPROC_COLOR_HPP
 #include "liteCV/core/lcvdef.hpp"
 #include "liteCV/core/matrix.hpp"
+#include "liteCV/core/parallel.hpp"
+#include "liteCV/core/simd.hpp"
 
 
 namespace lcv
@@ -28,66 +30,98 @@ namespace lcv
     void cvtColor_BGR2RGB(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC3);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC3);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC3, true);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0;y < src.rows;++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const Vec3b* src_stride = (Vec3b*)src.ptr(y);
-            Vec3b* dst_stride = (Vec3b*)dst_image.ptr(y);
+            const Vec3b* src_stride = (const Vec3b*)src_scanline;
+            Vec3b* dst_stride = (Vec3b*)dst_scanline;
 
-            for (int x = 0;x < src.cols;++x)
+            // Pixels are loaded before they are stored, so `src` and `dst` can be same
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
             {
-                dst_stride[x][0] = src_stride[x][2];
-                dst_stride[x][1] = src_stride[x][1];
-                dst_stride[x][2] = src_stride[x][0];
+                v_uint8x16 b, g, r;
+                v_load_deinterleave(src_scanline + x * 3, b, g, r);
+                v_store_interleave(dst_scanline + x * 3, r, g, b);
             }
-        }
 
-        dst = dst_image;
+            for (; x < width; ++x)
+            {
+                const Vec3b pixel = src_stride[x];
+                dst_stride[x][0] = pixel[2];
+                dst_stride[x][1] = pixel[1];
+                dst_stride[x][2] = pixel[0];
+            }
+        });
+
+        dst = std::move(dst_image);
     } // cvtColor_BGR2RGB
 
     void cvtColor_BGR2BGRA(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC3);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC4);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC4);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const Vec3b* src_stride = (Vec3b*)src.ptr(y);
-            Vec4b* dst_stride = (Vec4b*)dst_image.ptr(y);
+            const Vec3b* src_stride = (const Vec3b*)src_scanline;
+            Vec4b* dst_stride = (Vec4b*)dst_scanline;
+
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
+            {
+                v_uint8x16 b, g, r;
+                v_load_deinterleave(src_scanline + x * 3, b, g, r);
+                v_store_interleave(dst_scanline + x * 4, b, g, r, v_setzero_u8());
+            }
 
-            for (int x = 0; x < src.cols; ++x)
+            for (; x < width; ++x)
             {
                 dst_stride[x][0] = src_stride[x][0];
                 dst_stride[x][1] = src_stride[x][1];
                 dst_stride[x][2] = src_stride[x][2];
                 dst_stride[x][3] = 0;
             }
-        }
+        });
 
-        dst = dst_image;
+        dst = std::move(dst_image);
     } // cvtColor_BGR2BGRA
 
     void cvtColor_BGR2GRAY(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC3);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC1);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC1);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const Vec3b* src_stride = (Vec3b*)src.ptr(y);
-            uchar* dst_stride = dst_image.ptr(y);
+            const Vec3b* src_stride = (const Vec3b*)src_scanline;
+            uchar* dst_stride = dst_scanline;
+
+            // (sum * 21846) >> 16 is exactly sum / 3 for sums of three bytes
+            const v_uint16x8 third = v_setall_u16(21846);
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
+            {
+                v_uint8x16 b, g, r;
+                v_uint16x8 b0, b1, g0, g1, r0, r1;
+                v_load_deinterleave(src_scanline + x * 3, b, g, r);
+                v_expand(b, b0, b1);
+                v_expand(g, g0, g1);
+                v_expand(r, r0, r1);
+                v_store(dst_stride + x, v_pack(v_mul_hi(b0 + g0 + r0, third), v_mul_hi(b1 + g1 + r1, third)));
+            }
 
-            for (int x = 0; x < src.cols; ++x)
+            for (; x < width; ++x)
             {
                 dst_stride[x] = (uchar)(((int)src_stride[x][0] + src_stride[x][1] + src_stride[x][2]) / 3);
             }
-        }
+        });
 
-        dst = dst_image;
+        dst = std::move(dst_image);
     } // cvtColor_BGR2GRAY
 
 
@@ -97,66 +131,98 @@ namespace lcv
     void cvtColor_BGRA2RGBA(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC4);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC4);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC4, true);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const Vec4b* src_stride = (Vec4b*)src.ptr(y);
-            Vec4b* dst_stride = (Vec4b*)dst_image.ptr(y);
+            const Vec4b* src_stride = (const Vec4b*)src_scanline;
+            Vec4b* dst_stride = (Vec4b*)dst_scanline;
 
-            for (int x = 0; x < src.cols; ++x)
+            // Pixels are loaded before they are stored, so `src` and `dst` can be same
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
             {
-                dst_stride[x][0] = src_stride[x][2];
-                dst_stride[x][1] = src_stride[x][1];
-                dst_stride[x][2] = src_stride[x][0];
-                dst_stride[x][3] = src_stride[x][3];
+                v_uint8x16 b, g, r, a;
+                v_load_deinterleave(src_scanline + x * 4, b, g, r, a);
+                v_store_interleave(dst_scanline + x * 4, r, g, b, a);
             }
-        }
 
-        dst = dst_image;
+            for (; x < width; ++x)
+            {
+                const Vec4b pixel = src_stride[x];
+                dst_stride[x][0] = pixel[2];
+                dst_stride[x][1] = pixel[1];
+                dst_stride[x][2] = pixel[0];
+                dst_stride[x][3] = pixel[3];
+            }
+        });
+
+        dst = std::move(dst_image);
     } // cvtColor_BGRA2RGBA
 
     void cvtColor_BGRA2BGR(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC4);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC3);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC3);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const Vec4b* src_stride = (Vec4b*)src.ptr(y);
-            Vec3b* dst_stride = (Vec3b*)dst_image.ptr(y);
+            const Vec4b* src_stride = (const Vec4b*)src_scanline;
+            Vec3b* dst_stride = (Vec3b*)dst_scanline;
+
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
+            {
+                v_uint8x16 b, g, r, a;
+                v_load_deinterleave(src_scanline + x * 4, b, g, r, a);
+                v_store_interleave(dst_scanline + x * 3, b, g, r);
+            }
 
-            for (int x = 0; x < src.cols; ++x)
+            for (; x < width; ++x)
             {
                 dst_stride[x][0] = src_stride[x][0];
                 dst_stride[x][1] = src_stride[x][1];
                 dst_stride[x][2] = src_stride[x][2];
             }
-        }
+        });
 
-        dst = dst_image;
+        dst = std::move(dst_image);
     } // cvtColor_BGRA2BGR
 
     void cvtColor_BGRA2GRAY(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC4);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC1);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC1);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const Vec4b* src_stride = (Vec4b*)src.ptr(y);
-            uchar* dst_stride = (uchar*)dst_image.ptr(y);
+            const Vec4b* src_stride = (const Vec4b*)src_scanline;
+            uchar* dst_stride = (uchar*)dst_scanline;
+
+            // (sum * 21846) >> 16 is exactly sum / 3 for sums of three bytes
+            const v_uint16x8 third = v_setall_u16(21846);
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
+            {
+                v_uint8x16 b, g, r, a;
+                v_uint16x8 b0, b1, g0, g1, r0, r1;
+                v_load_deinterleave(src_scanline + x * 4, b, g, r, a);
+                v_expand(b, b0, b1);
+                v_expand(g, g0, g1);
+                v_expand(r, r0, r1);
+                v_store(dst_stride + x, v_pack(v_mul_hi(b0 + g0 + r0, third), v_mul_hi(b1 + g1 + r1, third)));
+            }
 
-            for (int x = 0; x < src.cols; ++x)
+            for (; x < width; ++x)
             {
                 dst_stride[x] = (uchar)(((int)src_stride[x][0] + src_stride[x][1] + src_stride[x][2]) / 3);
             }
-        }
+        });
 
-        dst = dst_image;
+        dst = std::move(dst_image);
     } // cvtColor_BGRA2BGR
 
 
@@ -166,46 +232,60 @@ namespace lcv
     void cvtColor_GRAY2BGR(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC1);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC3);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC3);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const uchar* src_stride = src.ptr(y);
-            Vec3b* dst_stride = (Vec3b*)dst_image.ptr(y);
+            const uchar* src_stride = src_scanline;
+            Vec3b* dst_stride = (Vec3b*)dst_scanline;
 
-            for (int x = 0; x < src.cols; ++x)
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
+            {
+                const v_uint8x16 v = v_load(src_stride + x);
+                v_store_interleave(dst_scanline + x * 3, v, v, v);
+            }
+
+            for (; x < width; ++x)
             {
                 dst_stride[x][0] = src_stride[x];
                 dst_stride[x][1] = src_stride[x];
                 dst_stride[x][2] = src_stride[x];
             }
-        }
+        });
 
-        dst = dst_image;
+        dst = std::move(dst_image);
     } // cvtColor_GRAY2BGR
 
     void cvtColor_GRAY2BGRA(const Matrix& src, Matrix& dst)
     {
         assert(src.type() == LCV_8UC1);
-        Matrix dst_image(src.cols, src.rows, LCV_8UC4);
+        Matrix dst_image = reuse_or_create(dst, src, src.cols, src.rows, LCV_8UC4);
 
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < src.rows; ++y)
+        parallel_for_scanlines(src, dst_image, [&](const uchar* src_scanline, uchar* dst_scanline, int width)
         {
-            const uchar* src_stride = src.ptr(y);
-            Vec4b* dst_stride = (Vec4b*)dst_image.ptr(y);
+            const uchar* src_stride = src_scanline;
+            Vec4b* dst_stride = (Vec4b*)dst_scanline;
 
-            for (int x = 0; x < src.cols; ++x)
+            const int vector_width = simd_width(width);
+            int x = 0;
+            for (; x <= vector_width - v_uint8x16::nlanes; x += v_uint8x16::nlanes)
+            {
+                const v_uint8x16 v = v_load(src_stride + x);
+                v_store_interleave(dst_scanline + x * 4, v, v, v, v_setzero_u8());
+            }
+
+            for (; x < width; ++x)
             {
                 dst_stride[x][0] = src_stride[x];
                 dst_stride[x][1] = src_stride[x];
                 dst_stride[x][2] = src_stride[x];
                 dst_stride[x][3] = 0;
             }
-        }
+        });
 
-        dst = dst_image;
+        dst = std::move(dst_image);
     } // cvtColor_GRAY2BGRA
 
     void cvtColor(const Matrix& src, Matrix& dst, int code)
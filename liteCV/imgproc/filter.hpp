@@ -1,79 +1,870 @@
 #pragma once
 #ifndef LCV_IMGPROC_FILTER_HPP
+#define LCV_IMGPROC_FILTER_HPP
 #include "liteCV/core/lcvdef.hpp"
 #include "liteCV/core/lcvmath.hpp"
 #include "liteCV/core/lcvtypes.hpp"
 #include "liteCV/core/saturate.hpp"
 #include "liteCV/core/matrix.hpp"
+#include "liteCV/core/parallel.hpp"
+#include "liteCV/core/cpu.hpp"
+#include "liteCV/core/convert.hpp"
+#include "liteCV/core/simd.hpp"
+#include <vector>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include "border.hpp"
 
 
 namespace lcv
 {
-    void filter2D(const Matrix& src, Matrix& dst, int ddepth, const Matrix& kernel, Point anchor = Point(-1, -1), double delta = 0, int borderType = BORDER_DEFAULT)
+    /* ///////////////////////////////////////
+    *  //    Kernels
+    */ //
+    std::vector<float> inline kernel_vector(const Matrix& kernel)
+    {
+        // Coefficients of a row or column kernel
+        assert(kernel.depth() == LCV_32F && kernel.channels() == 1 && (kernel.rows == 1 || kernel.cols == 1));
+
+        std::vector<float> v;
+        for (int y = 0; y < kernel.rows; ++y)
+            v.insert(v.end(), kernel.ptr<float>(y), kernel.ptr<float>(y) + kernel.cols);
+        return v;
+    } // kernel_vector
+
+    Point inline kernel_offset(const Size& ksize, const Point& anchor)
+    {
+        // Position of the first tap relative to the filtered pixel
+        // Every filter here takes `anchor` relative to the kernel center, `-1` keeps the center on that axis
+        return Point(-(ksize.width / 2) + (anchor.x != -1 ? anchor.x : 0), -(ksize.height / 2) + (anchor.y != -1 ? anchor.y : 0));
+    } // kernel_offset
+
+    bool inline separate_kernel(const Matrix& kernel, std::vector<float>& kx, std::vector<float>& ky)
+    {
+        // Rank-1 kernel is the outer product `ky[y] * kx[x]` of its column and row through the largest coefficient
+        int py = 0, px = 0;
+        float maxv = 0;
+        for (int y = 0; y < kernel.rows; ++y)
+        {
+            for (int x = 0; x < kernel.cols; ++x)
+            {
+                if (std::fabs(kernel.ptr<float>(y)[x]) > maxv)
+                {
+                    maxv = std::fabs(kernel.ptr<float>(y)[x]);
+                    py = y;
+                    px = x;
+                }
+            }
+        }
+        if (maxv == 0)
+            return false;
+
+        kx.resize(kernel.cols);
+        ky.resize(kernel.rows);
+        for (int x = 0; x < kernel.cols; ++x)
+            kx[x] = kernel.ptr<float>(py)[x] / kernel.ptr<float>(py)[px];
+        for (int y = 0; y < kernel.rows; ++y)
+            ky[y] = kernel.ptr<float>(y)[px];
+
+        const float eps = maxv * 1e-6f;
+        for (int y = 0; y < kernel.rows; ++y)
+        {
+            for (int x = 0; x < kernel.cols; ++x)
+            {
+                if (std::fabs(kernel.ptr<float>(y)[x] - ky[y] * kx[x]) > eps)
+                    return false;
+            }
+        }
+        return true;
+    } // separate_kernel
+
+    Matrix getGaussianKernel(int ksize, double sigma, int ktype = LCV_64F)
+    {
+        // `1 x ksize` column of Gaussian coefficients summing to 1, `ktype` is LCV_32F or LCV_64F
+        // Non-positive `sigma` is `0.3 * ((ksize - 1) * 0.5 - 1) + 0.8`, kernels of it up to 7 taps are binomial
+        assert(ksize > 0 && ksize % 2 == 1);
+
+        static const float64 binomial[4][7] =
+        {
+            { 1 },
+            { 0.25, 0.5, 0.25 },
+            { 0.0625, 0.25, 0.375, 0.25, 0.0625 },
+            { 0.03125, 0.109375, 0.21875, 0.28125, 0.21875, 0.109375, 0.03125 },
+        };
+
+        std::vector<float64> k(ksize);
+        if (sigma <= 0 && ksize <= 7)
+            std::copy(binomial[ksize / 2], binomial[ksize / 2] + ksize, k.begin());
+        else
+        {
+            if (sigma <= 0)
+                sigma = 0.3 * ((ksize - 1) * 0.5 - 1) + 0.8;
+
+            const float64 scale = -0.5 / (sigma * sigma);
+            float64 sum = 0;
+            for (int i = 0; i < ksize; ++i)
+            {
+                const float64 x = i - (ksize - 1) * 0.5;
+                k[i] = std::exp(scale * x * x);
+                sum += k[i];
+            }
+            for (int i = 0; i < ksize; ++i)
+                k[i] /= sum;
+        }
+
+        MatrixType type(ktype);
+        type.packed.fields.channels = 1;
+        Matrix kernel(1, ksize, type.packed.value);
+        for (int i = 0; i < ksize; ++i)
+        {
+            if (kernel.depth() == LCV_32F)
+                kernel.ptr<float32>(i)[0] = (float32)k[i];
+            else if (kernel.depth() == LCV_64F)
+                kernel.ptr<float64>(i)[0] = k[i];
+            else
+                assert(0 && "Unsupported kernel type");
+        }
+        return kernel;
+    } // getGaussianKernel
+
+
+    /* ///////////////////////////////////////
+    *  //    Filter engine
+    */ //
+    template<typename ST, typename WT>
+    struct FilterTypes
+    {
+        // Elements of source and of rows of FilterEngine
+    }; // struct FilterTypes
+
+    struct NoRowOp
+    {
+        // Row operation of FilterEngine without a row pass, extended scanlines are rows of the ring as they are
+        template<typename WT>
+        void operator()(const WT* /*ext*/, WT* /*row*/) const {}
+    }; // struct NoRowOp
+
+    template<typename Policy>
+    struct FilterEngine
+    {
+        // Row `k` of the window of scanline `y` is source scanline `y + offset.y + k` extended by border,
+        // pixel `j` of the window of pixel `x` is its pixel `x + offset.x + j`
+        // Extended scanlines are converted to `WT` once and kept in a ring, or their results of `row_op(ext, ring_row)`
+        // if `ring_width` is not zero, then `column_op(ring_rows, leaving, sums, output_scanline)` combines `ksize.height`
+        // rows into `sums` and stores them, `leaving` is the ring row which left the window after previous scanline of same part,
+        // `NULL` for the first scanline, `sums` are kept between scanlines of a part for running sums
+        // Border pixels are pre-computed, so both operations run over the whole scanline without branches
+        // Only `roi` of `src` is filtered into `output`, pixels of `src` around it are read instead of border, see `border_source`
+        template<typename ST, typename WT, typename RowOp, typename ColumnOp>
+        static void run(FilterTypes<ST, WT>, const Matrix& src, const Rect& roi, Matrix& output, const Size& ksize, const Point& offset,
+            const Scalar& borderValue, int ring_width, const RowOp& row_op, const ColumnOp& column_op)
+        {
+            assert(src.elemSize1() == sizeof(ST));
+
+            const int channels = src.channels();
+            const int width = roi.width * channels;
+            const int ext_cols = roi.width + ksize.width - 1;
+            const int ext_width = ext_cols * channels;
+            const int row_width = ring_width != 0 ? ring_width : ext_width;
+            const int ring_rows = ksize.height + 1;
+            const size_t scanline_bytes = (size_t)src.cols * src.elemSize();
+
+            // Column of `src` under the first pixel of extended scanline
+            const int left = roi.x + offset.x;
+
+            // Source pixel of each pixel of extended scanline, `-1` for constant border
+            // Pixels inside the image are a single run
+            std::vector<int> xmap(ext_cols);
+            for (int i = 0; i < ext_cols; ++i)
+                xmap[i] = Policy::calculate(i + left, src.cols);
+            const int inner_start = std::min(std::max(0, -left), ext_cols);
+            const int inner_end = std::max(std::min(ext_cols, src.cols - left), inner_start);
+
+            // Scanline of constant border
+            std::vector<WT> constant_row(ext_width);
+            for (int i = 0; i < ext_width; ++i)
+                constant_row[i] = saturate_cast<WT>(saturate_cast<ST>(borderValue[i % channels % 4]));
+
+            // Scanlines filtered in place are processed in stripes, a stripe reads source scanlines `[y, end)` in place
+            // when scanline `y` is filtered, other scanlines of `roi` are saved before any stripe starts
+            const bool in_place = output.isSameView(src(roi));
+            const int stripes = in_place ? std::max(1, std::min(getNumThreads(), roi.height / ksize.height)) : 1;
+            auto stripe = [&](int s) { return Range(roi.height * s / stripes, roi.height * (s + 1) / stripes); };
+            auto in_stripe = [&](const Range& r, int y, int ry)
+            {
+                return !in_place || ry < roi.y || ry >= roi.y + roi.height || (ry - roi.y >= y && ry - roi.y < r.end);
+            };
+
+            std::vector<int> saved_index(in_place ? src.rows : 0, -1);
+            int saved_rows = 0;
+            for (int s = 0; s < stripes && in_place; ++s)
+            {
+                const Range r = stripe(s);
+                for (int v = r.start + offset.y; v < r.end + offset.y + ksize.height - 1; ++v)
+                {
+                    // Scanline `v` enters the ring when scanline `y` is filtered
+                    const int y = std::max(r.start, v - offset.y - ksize.height + 1);
+                    const int ry = Policy::calculate(v + roi.y, src.rows);
+                    if (ry >= 0 && !in_stripe(r, y, ry) && saved_index[ry] < 0)
+                        saved_index[ry] = saved_rows++;
+                }
+            }
+
+            std::vector<uchar> saved((size_t)saved_rows * scanline_bytes);
+            for (int y = 0; y < (int)saved_index.size(); ++y)
+            {
+                if (saved_index[y] >= 0)
+                    memcpy(&saved[saved_index[y] * scanline_bytes], src.ptr(y), scanline_bytes);
+            }
+
+            auto filter_rows = [&](const Range& r)
+            {
+                std::vector<WT> ext(ext_width);
+                std::vector<WT> ring((size_t)ring_rows * row_width);
+                std::vector<const WT*> rows(ksize.height);
+                std::vector<WT> sums(width);
+                auto ring_row = [&](int v) { return &ring[(size_t)(((v % ring_rows) + ring_rows) % ring_rows) * row_width]; };
+
+                auto extend = [&](const ST* scanline, WT* out)
+                {
+                    if (scanline == NULL)
+                    {
+                        std::copy(constant_row.begin(), constant_row.end(), out);
+                        return;
+                    }
+
+                    for (int i = 0; i < inner_start; ++i)
+                    {
+                        for (int ch = 0; ch < channels; ++ch)
+                            out[i * channels + ch] = xmap[i] < 0 ? constant_row[i * channels + ch] : scanline[xmap[i] * channels + ch];
+                    }
+
+                    const ST* inner = scanline + (ptrdiff_t)(inner_start + left) * channels;
+                    WT* inner_out = out + inner_start * channels;
+                    const int inner_width = (inner_end - inner_start) * channels;
+                    for (int j = 0; j < inner_width; ++j)
+                        inner_out[j] = inner[j];
+
+                    for (int i = inner_end; i < ext_cols; ++i)
+                    {
+                        for (int ch = 0; ch < channels; ++ch)
+                            out[i * channels + ch] = xmap[i] < 0 ? constant_row[i * channels + ch] : scanline[xmap[i] * channels + ch];
+                    }
+                };
+
+                // Compiled for the CPU level selected at runtime
+                cpu_dispatch([&]()
+                {
+                    int next = r.start + offset.y;
+                    for (int y = r.start; y < r.end; ++y)
+                    {
+                        // Scanlines entering the ring
+                        for (; next < y + offset.y + ksize.height; ++next)
+                        {
+                            const int ry = Policy::calculate(next + roi.y, src.rows);
+                            const uchar* scanline = ry < 0 ? NULL : in_stripe(r, y, ry) ? src.ptr(ry) : &saved[saved_index[ry] * scanline_bytes];
+                            if (ring_width == 0)
+                                extend((const ST*)scanline, ring_row(next));
+                            else
+                            {
+                                extend((const ST*)scanline, ext.data());
+                                row_op((const WT*)ext.data(), ring_row(next));
+                            }
+                        }
+
+                        for (int k = 0; k < ksize.height; ++k)
+                            rows[k] = ring_row(y + offset.y + k);
+                        const WT* leaving = y > r.start ? ring_row(y + offset.y - 1) : NULL;
+                        column_op((const WT* const*)rows.data(), leaving, sums.data(), output.ptr(y));
+                    }
+                });
+            };
+
+            if (in_place)
+            {
+                parallel_for_(Range(0, stripes), [&](const Range& range)
+                {
+                    for (int s = range.start; s < range.end; ++s)
+                        filter_rows(stripe(s));
+                }, 1);
+            }
+            else
+            {
+                // Each part fills the ring with `ksize.height - 1` extra scanlines
+                parallel_for_(Range(0, roi.height), filter_rows,
+                    std::max(parallel_grain((int64)width * ksize.width * ksize.height), ksize.height * 4));
+            }
+        }
+
+        template<typename ST, typename WT, typename ColumnOp>
+        static void run(FilterTypes<ST, WT> types, const Matrix& src, const Rect& roi, Matrix& output, const Size& ksize, const Point& offset,
+            const Scalar& borderValue, const ColumnOp& column_op)
+        {
+            // No row pass, `column_op` combines extended scanlines of `ksize.width + roi.width - 1` pixels
+            run(types, src, roi, output, ksize, offset, borderValue, 0, NoRowOp(), column_op);
+        }
+    }; // struct FilterEngine
+
+    Matrix inline filter_output(Matrix& dst, const Matrix& src, const Matrix& source, int type)
+    {
+        // Output header for filtering `src` read with pixels of `source` around it, see `border_source`
+        // `dst` can be `src`, other views sharing pixels read by the filter get a new buffer
+        Matrix output = dst.isSameView(src) || !source.overlaps(dst) ? dst : Matrix();
+        output.create(src.cols, src.rows, type);
+        return output;
+    } // filter_output
+
+    void filter_separable(const Matrix& src, Matrix& dst, int ddepth, const std::vector<float>& kx, const std::vector<float>& ky,
+        const Point& offset, double delta, int borderType, const Scalar& borderValue)
+    {
+        // Only support 8-bits depth image, `-1` means same as source
+        assert(src.depth() == LCV_8U && (ddepth == LCV_8U || ddepth == -1));
+        assert(!src.isPlanar());
+
+        // Windows read pixels of the parent of ROI, as if the parent was filtered
+        Rect roi;
+        const Matrix source = border_source(src, borderType, roi);
+        assert(source.cols > (int)kx.size() && source.rows > (int)ky.size());
+
+        // `src` and `dst` can be same
+        Matrix output = filter_output(dst, src, source, src.type());
+
+        // Source scanlines are filtered horizontally into the ring, the ring is filtered vertically
+        const int width = src.cols * src.channels();
+        const int channels = src.channels();
+        const float fdelta = (float)delta;
+        auto row_op = [&](const float* ext, float* row)
+        {
+            for (int j = 0; j < width; ++j)
+                row[j] = kx[0] * ext[j];
+            for (int k = 1; k < (int)kx.size(); ++k)
+            {
+                const float* e = ext + k * channels;
+                for (int j = 0; j < width; ++j)
+                    row[j] += kx[k] * e[j];
+            }
+        };
+        auto column_op = [&](const float* const* rows, const float* /*leaving*/, float* sums, uchar* out)
+        {
+            for (int j = 0; j < width; ++j)
+                sums[j] = ky[0] * rows[0][j];
+            for (int k = 1; k < (int)ky.size(); ++k)
+            {
+                const float* row = rows[k];
+                for (int j = 0; j < width; ++j)
+                    sums[j] += ky[k] * row[j];
+            }
+            for (int j = 0; j < width; ++j)
+                sums[j] += fdelta;
+            saturate_cast<uchar>(sums, out, width);
+        };
+
+        with_border_policy<FilterEngine>(borderType & ~BORDER_ISOLATED, FilterTypes<uchar, float>(), source, roi, output,
+            Size((int)kx.size(), (int)ky.size()), offset, borderValue, width, row_op, column_op);
+        dst = std::move(output);
+    } // filter_separable
+
+
+    /* ///////////////////////////////////////
+    *  //    Box filter
+    */ //
+    template<typename WT, typename DT>
+    void store_sums(const WT* sums, uchar* out, int n, double scale)
+    {
+        if (scale == 1)
+            Convert<WT, DT>::run(sums, (DT*)out, n);
+        else
+            ConvertScale<WT, DT, float64>::run(sums, (DT*)out, n, scale, 0);
+    } // store_sums
+
+    template<typename WT>
+    using StoreSums = void (*)(const WT* sums, uchar* out, int n, double scale);
+
+    template<typename WT>
+    StoreSums<WT> store_sums_of(int ddepth)
+    {
+        // Stores sums of a scanline as `ddepth` elements
+        if (ddepth == LCV_8U)
+            return store_sums<WT, uchar>;
+        else if (ddepth == LCV_8S)
+            return store_sums<WT, schar>;
+        else if (ddepth == LCV_16U)
+            return store_sums<WT, ushort>;
+        else if (ddepth == LCV_16S)
+            return store_sums<WT, short>;
+        else if (ddepth == LCV_32U)
+            return store_sums<WT, uint>;
+        else if (ddepth == LCV_32S)
+            return store_sums<WT, int>;
+        else if (ddepth == LCV_32F)
+            return store_sums<WT, float32>;
+        else if (ddepth == LCV_64F)
+            return store_sums<WT, float64>;
+
+        assert(0 && "Unsupported depth");
+        return NULL;
+    } // store_sums_of
+
+    template<bool Square, typename WT>
+    void box_row_sums(const WT* ext, WT* row, int width, int channels, int kwidth)
+    {
+        // Sliding window: the sum of pixel `x` is the sum of pixel `x - 1` plus the entering pixel minus the leaving one
+        for (int ch = 0; ch < channels && ch < width; ++ch)
+        {
+            WT s = 0;
+            for (int k = 0; k < kwidth; ++k)
+                s += Square ? ext[ch + k * channels] * ext[ch + k * channels] : ext[ch + k * channels];
+            row[ch] = s;
+        }
+
+        const WT* enter = ext + kwidth * channels;
+        for (int j = channels; j < width; ++j)
+        {
+            const WT a = enter[j - channels], b = ext[j - channels];
+            row[j] = row[j - channels] + (Square ? a * a - b * b : a - b);
+        }
+    } // box_row_sums
+
+    template<typename ST, typename WT>
+    void box_filter(const Matrix& source, const Rect& roi, Matrix& output, const Size& ksize, const Point& offset, bool normalize, bool square,
+        int borderType)
+    {
+        // Rows are summed by a sliding window into the ring, sums of columns are running sums over the ring
+        // so a pixel costs same for any `ksize`
+        const int channels = source.channels();
+        const int width = roi.width * channels;
+        const double scale = normalize ? 1. / ((double)ksize.width * ksize.height) : 1.;
+        const auto store = store_sums_of<WT>(output.depth());
+
+        auto row_op = [&](const WT* ext, WT* row)
+        {
+            if (square)
+                box_row_sums<true>(ext, row, width, channels, ksize.width);
+            else
+                box_row_sums<false>(ext, row, width, channels, ksize.width);
+        };
+        auto column_op = [&](const WT* const* rows, const WT* leaving, WT* sums, uchar* out)
+        {
+            if (leaving == NULL)
+            {
+                std::copy(rows[0], rows[0] + width, sums);
+                for (int k = 1; k < ksize.height; ++k)
+                {
+                    for (int j = 0; j < width; ++j)
+                        sums[j] += rows[k][j];
+                }
+            }
+            else
+            {
+                const WT* entering = rows[ksize.height - 1];
+                for (int j = 0; j < width; ++j)
+                    sums[j] += entering[j] - leaving[j];
+            }
+            store(sums, out, width, scale);
+        };
+
+        with_border_policy<FilterEngine>(borderType & ~BORDER_ISOLATED, FilterTypes<ST, WT>(), source, roi, output, ksize, offset, Scalar(),
+            width, row_op, column_op);
+    } // box_filter
+
+    void box_filter(const Matrix& src, Matrix& dst, int ddepth, const Size& ksize, const Point& offset, bool normalize, bool square, int borderType)
+    {
+        // Interleaved channels of 8-bits, 16-bits or float images
+        assert(!src.isPlanar());
+        assert(ksize.width > 0 && ksize.height > 0);
+
+        // Windows read pixels of the parent of ROI, as if the parent was filtered
+        Rect roi;
+        const Matrix source = border_source(src, borderType, roi);
+        assert(source.cols > ksize.width && source.rows > ksize.height);
+
+        // `src` and `dst` can be same when `ddepth` is depth of `src`
+        MatrixType type(ddepth);
+        type.packed.fields.channels = src.channels();
+        Matrix output = filter_output(dst, src, source, type.packed.value);
+
+        // 8-bits sums are exact 32-bits integers unless windows are too large for squares, others are summed in float64
+        const int depth = src.depth();
+        const int64 area = (int64)ksize.width * ksize.height;
+        if (depth == LCV_8U && area * (square ? 255 * 255 : 255) <= std::numeric_limits<int>::max())
+            box_filter<uchar, int>(source, roi, output, ksize, offset, normalize, square, borderType);
+        else if (depth == LCV_8U)
+            box_filter<uchar, float64>(source, roi, output, ksize, offset, normalize, square, borderType);
+        else if (depth == LCV_16U)
+            box_filter<ushort, float64>(source, roi, output, ksize, offset, normalize, square, borderType);
+        else if (depth == LCV_16S)
+            box_filter<short, float64>(source, roi, output, ksize, offset, normalize, square, borderType);
+        else if (depth == LCV_32F)
+            box_filter<float32, float64>(source, roi, output, ksize, offset, normalize, square, borderType);
+        else
+            assert(0 && "Unsupported depth");
+
+        dst = std::move(output);
+    } // box_filter
+
+
+    /* ///////////////////////////////////////
+    *  //    Gaussian blur
+    */ //
+    std::vector<int> inline gaussian_fixed_kernel(int ksize, double sigma)
+    {
+        // Q8 coefficients of `getGaussianKernel`, symmetric, non-negative and summing to exactly `1 << 8`
+        // Coefficients are rounded down, units left go to the center and to symmetric pairs of largest fractions
+        const Matrix kernel = getGaussianKernel(ksize, sigma, LCV_64F);
+        std::vector<int> c(ksize);
+        std::vector<std::pair<float64, int> > fractions;
+        int left = 1 << 8;
+        for (int i = 0; i < ksize; ++i)
+        {
+            const float64 v = kernel.ptr<float64>(i)[0] * (1 << 8);
+            c[i] = lcvFloor(v);
+            left -= c[i];
+            if (i < ksize / 2)
+                fractions.push_back(std::make_pair(v - c[i], i));
+        }
+
+        if (left % 2 != 0)
+        {
+            c[ksize / 2] += 1;
+            left -= 1;
+        }
+
+        std::sort(fractions.begin(), fractions.end(), [](const std::pair<float64, int>& a, const std::pair<float64, int>& b)
+        {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+        for (int k = 0; left > 0; ++k, left -= 2)
+        {
+            c[fractions[k].second] += 1;
+            c[ksize - 1 - fractions[k].second] += 1;
+        }
+        return c;
+    } // gaussian_fixed_kernel
+
+    v_uint8x16 inline gaussian_pack(const v_int32x4& a, const v_int32x4& b, const v_int32x4& c, const v_int32x4& d)
+    {
+        // Q16 sums of 16 pixels rounded to 8-bits
+        const v_int32x4 half = v_setall_s32(1 << 15);
+        return v_pack_u(v_pack(v_shr<16>(a + half), v_shr<16>(b + half)), v_pack(v_shr<16>(c + half), v_shr<16>(d + half)));
+    } // gaussian_pack
+
+    template<int Taps>
+    struct GaussianRow
+    {
+        // `row[j]` is the Q8 sum of `c[k] * ext[j + k * channels]` of a symmetric kernel, taps of same coefficient are added first
+        // Any number of taps is accumulated tap by tap over the scanline, 3 and 5 taps keep coefficients in registers
+        static void run(const int* ext, int* row, int width, int channels, const int* c, int taps)
+        {
+            const int lanes = v_int32x4::nlanes;
+            const int half = taps / 2;
+            const int* center = ext + half * channels;
+            const int vector_width = simd_width(width);
+            for (int j = 0; j < width; ++j)
+                row[j] = c[half] * center[j];
+
+            for (int k = 0; k < half; ++k)
+            {
+                const int* a = ext + k * channels;
+                const int* b = ext + (taps - 1 - k) * channels;
+                const v_int32x4 ck = v_setall_s32(c[k]);
+                int j = 0;
+                for (; j <= vector_width - lanes; j += lanes)
+                    v_store(row + j, v_load(row + j) + (v_load(a + j) + v_load(b + j)) * ck);
+                for (; j < width; ++j)
+                    row[j] += c[k] * (a[j] + b[j]);
+            }
+        }
+    }; // struct GaussianRow
+
+    template<>
+    struct GaussianRow<3>
+    {
+        static void run(const int* ext, int* row, int width, int channels, const int* c, int /*taps*/)
+        {
+            const int lanes = v_int32x4::nlanes;
+            const int* e0 = ext;
+            const int* e1 = ext + channels;
+            const int* e2 = ext + channels * 2;
+            const v_int32x4 c0 = v_setall_s32(c[0]), c1 = v_setall_s32(c[1]);
+            const int vector_width = simd_width(width);
+            int j = 0;
+            for (; j <= vector_width - lanes; j += lanes)
+                v_store(row + j, (v_load(e0 + j) + v_load(e2 + j)) * c0 + v_load(e1 + j) * c1);
+            for (; j < width; ++j)
+                row[j] = c[0] * (e0[j] + e2[j]) + c[1] * e1[j];
+        }
+    }; // struct GaussianRow
+
+    template<>
+    struct GaussianRow<5>
+    {
+        static void run(const int* ext, int* row, int width, int channels, const int* c, int /*taps*/)
+        {
+            const int lanes = v_int32x4::nlanes;
+            const int* e0 = ext;
+            const int* e1 = ext + channels;
+            const int* e2 = ext + channels * 2;
+            const int* e3 = ext + channels * 3;
+            const int* e4 = ext + channels * 4;
+            const v_int32x4 c0 = v_setall_s32(c[0]), c1 = v_setall_s32(c[1]), c2 = v_setall_s32(c[2]);
+            const int vector_width = simd_width(width);
+            int j = 0;
+            for (; j <= vector_width - lanes; j += lanes)
+            {
+                v_store(row + j, (v_load(e0 + j) + v_load(e4 + j)) * c0 + (v_load(e1 + j) + v_load(e3 + j)) * c1 +
+                    v_load(e2 + j) * c2);
+            }
+            for (; j < width; ++j)
+                row[j] = c[0] * (e0[j] + e4[j]) + c[1] * (e1[j] + e3[j]) + c[2] * e2[j];
+        }
+    }; // struct GaussianRow
+
+    template<int Taps>
+    struct GaussianColumn
+    {
+        // `out[j]` is the Q16 sum of `c[k] * rows[k][j]` rounded to 8-bits, `sums` keeps Q16 sums of the scanline
+        // Any number of taps is accumulated tap by tap over the scanline, 3 and 5 taps sum 16 pixels in registers
+        static void run(const int* const* rows, int* sums, uchar* out, int width, const int* c, int taps)
+        {
+            const int lanes = v_int32x4::nlanes;
+            const int half = taps / 2;
+            const int vector_width = simd_width(width);
+            for (int j = 0; j < width; ++j)
+                sums[j] = c[half] * rows[half][j];
+
+            for (int k = 0; k < half; ++k)
+            {
+                const int* a = rows[k];
+                const int* b = rows[taps - 1 - k];
+                const v_int32x4 ck = v_setall_s32(c[k]);
+                int j = 0;
+                for (; j <= vector_width - lanes; j += lanes)
+                    v_store(sums + j, v_load(sums + j) + (v_load(a + j) + v_load(b + j)) * ck);
+                for (; j < width; ++j)
+                    sums[j] += c[k] * (a[j] + b[j]);
+            }
+
+            int j = 0;
+            for (; j <= vector_width - v_uint8x16::nlanes; j += v_uint8x16::nlanes)
+                v_store(out + j, gaussian_pack(v_load(sums + j), v_load(sums + j + 4), v_load(sums + j + 8), v_load(sums + j + 12)));
+            for (; j < width; ++j)
+                out[j] = saturate_cast<uchar>((sums[j] + (1 << 15)) >> 16);
+        }
+    }; // struct GaussianColumn
+
+    template<>
+    struct GaussianColumn<3>
+    {
+        static v_int32x4 sum(const int* const* rows, int j, const v_int32x4& c0, const v_int32x4& c1)
+        {
+            return (v_load(rows[0] + j) + v_load(rows[2] + j)) * c0 + v_load(rows[1] + j) * c1;
+        }
+
+        static void run(const int* const* rows, int* /*sums*/, uchar* out, int width, const int* c, int /*taps*/)
+        {
+            const v_int32x4 c0 = v_setall_s32(c[0]), c1 = v_setall_s32(c[1]);
+            const int vector_width = simd_width(width);
+            int j = 0;
+            for (; j <= vector_width - v_uint8x16::nlanes; j += v_uint8x16::nlanes)
+            {
+                v_store(out + j, gaussian_pack(sum(rows, j, c0, c1), sum(rows, j + 4, c0, c1), sum(rows, j + 8, c0, c1),
+                    sum(rows, j + 12, c0, c1)));
+            }
+            for (; j < width; ++j)
+                out[j] = saturate_cast<uchar>((c[0] * (rows[0][j] + rows[2][j]) + c[1] * rows[1][j] + (1 << 15)) >> 16);
+        }
+    }; // struct GaussianColumn
+
+    template<>
+    struct GaussianColumn<5>
+    {
+        static v_int32x4 sum(const int* const* rows, int j, const v_int32x4& c0, const v_int32x4& c1, const v_int32x4& c2)
+        {
+            return (v_load(rows[0] + j) + v_load(rows[4] + j)) * c0 + (v_load(rows[1] + j) + v_load(rows[3] + j)) * c1 +
+                v_load(rows[2] + j) * c2;
+        }
+
+        static void run(const int* const* rows, int* /*sums*/, uchar* out, int width, const int* c, int /*taps*/)
+        {
+            const v_int32x4 c0 = v_setall_s32(c[0]), c1 = v_setall_s32(c[1]), c2 = v_setall_s32(c[2]);
+            const int vector_width = simd_width(width);
+            int j = 0;
+            for (; j <= vector_width - v_uint8x16::nlanes; j += v_uint8x16::nlanes)
+            {
+                v_store(out + j, gaussian_pack(sum(rows, j, c0, c1, c2), sum(rows, j + 4, c0, c1, c2), sum(rows, j + 8, c0, c1, c2),
+                    sum(rows, j + 12, c0, c1, c2)));
+            }
+            for (; j < width; ++j)
+            {
+                const int s = c[0] * (rows[0][j] + rows[4][j]) + c[1] * (rows[1][j] + rows[3][j]) + c[2] * rows[2][j];
+                out[j] = saturate_cast<uchar>((s + (1 << 15)) >> 16);
+            }
+        }
+    }; // struct GaussianColumn
+
+    void gaussian_blur(const Matrix& src, Matrix& dst, const std::vector<int>& kx, const std::vector<int>& ky, int borderType)
+    {
+        // Only support 8-bits depth image, channels are interleaved
+        assert(src.depth() == LCV_8U);
+        assert(!src.isPlanar());
+
+        // Windows read pixels of the parent of ROI, as if the parent was filtered
+        Rect roi;
+        const Matrix source = border_source(src, borderType, roi);
+        assert(source.cols > (int)kx.size() && source.rows > (int)ky.size());
+
+        // `src` and `dst` can be same, see FilterEngine
+        Matrix output = filter_output(dst, src, source, src.type());
+
+        // Rows are Q8 sums of at most 16 bits, columns are Q16 sums of them, all exact in 32-bits integers
+        const int channels = src.channels();
+        const int width = src.cols * channels;
+        const int kwidth = (int)kx.size(), kheight = (int)ky.size();
+        auto row_op = [&](const int* ext, int* row)
+        {
+            if (kwidth == 3)
+                GaussianRow<3>::run(ext, row, width, channels, kx.data(), kwidth);
+            else if (kwidth == 5)
+                GaussianRow<5>::run(ext, row, width, channels, kx.data(), kwidth);
+            else
+                GaussianRow<0>::run(ext, row, width, channels, kx.data(), kwidth);
+        };
+        auto column_op = [&](const int* const* rows, const int* /*leaving*/, int* sums, uchar* out)
+        {
+            if (kheight == 3)
+                GaussianColumn<3>::run(rows, sums, out, width, ky.data(), kheight);
+            else if (kheight == 5)
+                GaussianColumn<5>::run(rows, sums, out, width, ky.data(), kheight);
+            else
+                GaussianColumn<0>::run(rows, sums, out, width, ky.data(), kheight);
+        };
+
+        with_border_policy<FilterEngine>(borderType & ~BORDER_ISOLATED, FilterTypes<uchar, int>(), source, roi, output,
+            Size(kwidth, kheight), Point(-(kwidth / 2), -(kheight / 2)), Scalar(), width, row_op, column_op);
+        dst = std::move(output);
+    } // gaussian_blur
+
+
+    /* ///////////////////////////////////////
+    *  //    Filters
+    */ //
+    void sepFilter2D(const Matrix& src, Matrix& dst, int ddepth, const Matrix& kernelX, const Matrix& kernelY, Point anchor = Point(-1, -1), double delta = 0,
+        int borderType = BORDER_DEFAULT, const Scalar& borderValue = Scalar())
+    {
+        // Filter rows by `kernelX` then columns by `kernelY`, kernels are 32-bits float rows or columns
+        // `anchor` is relative to the kernel center as in filter2D, see kernel_offset
+        const std::vector<float> kx = kernel_vector(kernelX), ky = kernel_vector(kernelY);
+        const Point offset = kernel_offset(Size((int)kx.size(), (int)ky.size()), anchor);
+        filter_separable(src, dst, ddepth, kx, ky, offset, delta, borderType, borderValue);
+    } // sepFilter2D
+
+    void filter2D(const Matrix& src, Matrix& dst, int ddepth, const Matrix& kernel, Point anchor = Point(-1, -1), double delta = 0,
+        int borderType = BORDER_DEFAULT, const Scalar& borderValue = Scalar())
     {
         // Only support 8-bits depth image
         // `-1` means same as source
         assert(src.depth() == LCV_8U && (ddepth == LCV_8U || ddepth == -1));
 
+        // Channels are interleaved, filter planes of PLANAR matrix one by one
+        assert(!src.isPlanar());
+
         // Kernel must be 32-bits float
         assert(kernel.depth() == LCV_32F);
 
-        // Check sizes of matrix
+        // Check sizes of kernel
         assert(kernel.cols % 2 != 0 && kernel.rows % 2 != 0);
-        assert(src.cols > kernel.cols && src.rows > kernel.rows);
 
-        Matrix output(src.cols, src.rows, src.type());
+        const Point offset = kernel_offset(Size(kernel.cols, kernel.rows), anchor);
 
-        // Loop height
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < output.rows; ++y)
+        // Rank-1 kernels take `kernel.rows + kernel.cols` instead of `kernel.rows * kernel.cols` multiplications per pixel
+        std::vector<float> kx, ky;
+        if (kernel.rows > 1 && kernel.cols > 1 && separate_kernel(kernel, kx, ky))
         {
-            // Loop width
-            for (int x = 0; x < output.cols; ++x)
-            {
-                // Loop channel
-                for (int ch = 0; ch < output.channels(); ++ch)
-                {
-                    // Loop convolve
-                    float sum = 0;
-                    for (int ky = 0; ky < kernel.rows; ky++)
-                    {
-                        const float* krnl_scanline = kernel.ptr<float>(ky);
-                        for (int kx = 0; kx < kernel.cols; ++kx)
-                        {
-                            BorderPolicy* bp = BorderPolicyStorage::get_policy(borderType);
+            filter_separable(src, dst, ddepth, kx, ky, offset, delta, borderType, borderValue);
+            return;
+        }
 
-                            const int ry = bp->calculate(y - (kernel.rows / 2) + ky + (anchor.y != -1 ? anchor.y : 0), output.rows);
-                            const int rx = bp->calculate(x - (kernel.cols / 2) + kx + (anchor.x != -1 ? anchor.x : 0), output.cols);
+        // Windows read pixels of the parent of ROI, as if the parent was filtered
+        Rect roi;
+        const Matrix source = border_source(src, borderType, roi);
+        assert(source.cols > kernel.cols && source.rows > kernel.rows);
 
-                            sum += (krnl_scanline[kx] * (int)src.ptr<uchar>(ry, rx)[ch]);
-                        }
-                    } // Conolve
+        // `src` and `dst` can be same, see FilterEngine
+        Matrix output = filter_output(dst, src, source, src.type());
 
-                    output.ptr<uchar>(y, x)[ch] = saturate_cast<uchar>(sum + delta);
-                } // Channel
-            } // Width 
-        } // Height
+        // Each tap of the kernel is a multiply-add of a shifted extended scanline
+        const int channels = src.channels();
+        const int width = src.cols * channels;
+        const float fdelta = (float)delta;
+        std::vector<float> coefficients;
+        for (int ky = 0; ky < kernel.rows; ++ky)
+            coefficients.insert(coefficients.end(), kernel.ptr<float>(ky), kernel.ptr<float>(ky) + kernel.cols);
+        auto column_op = [&](const float* const* rows, const float* /*leaving*/, float* sums, uchar* out)
+        {
+            std::fill(sums, sums + width, 0.f);
+            for (int ky = 0; ky < kernel.rows; ++ky)
+            {
+                for (int kx = 0; kx < kernel.cols; ++kx)
+                {
+                    const float k = coefficients[ky * kernel.cols + kx];
+                    if (k == 0)
+                        continue;
 
-        dst = output;
+                    const float* e = rows[ky] + kx * channels;
+                    for (int j = 0; j < width; ++j)
+                        sums[j] += k * e[j];
+                }
+            }
+            for (int j = 0; j < width; ++j)
+                sums[j] += fdelta;
+            saturate_cast<uchar>(sums, out, width);
+        };
+
+        with_border_policy<FilterEngine>(borderType & ~BORDER_ISOLATED, FilterTypes<uchar, float>(), source, roi, output,
+            Size(kernel.cols, kernel.rows), offset, borderValue, column_op);
+        dst = std::move(output);
     } // filter2D
 
     void boxFilter(const Matrix& src, Matrix& dst, int ddepth, Size ksize, Point anchor = Point(-1, -1), bool normalize = true, int borderType = BORDER_DEFAULT)
     {
-        // Make box filter
-        lcv::Mat kernel(ksize.width, ksize.height, 1, LCV_32F);
-        for (int i = 0; i < kernel.cols * kernel.rows; ++i)
-            kernel.ptr<float>()[i] = normalize ? (1.f / (ksize.width * ksize.height)) : 1.f;
-
-        // Convolve filter
-        filter2D(src, dst, ddepth, kernel, anchor, 0., borderType);
+        // Sums or means of `ksize` windows, `anchor` is relative to the center as in filter2D
+        // Costs same for any `ksize`, unnormalized sums of 8-bits image can be stored to LCV_16U or LCV_32S `ddepth`
+        const Point offset = kernel_offset(ksize, anchor);
+        box_filter(src, dst, ddepth < 0 ? src.depth() : ddepth, ksize, offset, normalize, false, borderType);
     } // boxFilter
 
     void blur(const Matrix& src, Matrix& dst, Size size, Point anchor = Point(-1, -1), int borderType = BORDER_DEFAULT)
     {
         boxFilter(src, dst, src.depth(), size, anchor, true, borderType);
     } // blur
-}; // namespace lcv
+
+    void sqrBoxFilter(const Matrix& src, Matrix& dst, int ddepth, Size ksize, Point anchor = Point(-1, -1), bool normalize = true,
+        int borderType = BORDER_DEFAULT)
+    {
+        // Sums or means of squares of `ksize` windows, local variance is `sqrBoxFilter - boxFilter^2` of float box
+        // `-1` means LCV_32F for integer images, LCV_64F for float images
+        const Point offset = kernel_offset(ksize, anchor);
+        if (ddepth < 0)
+            ddepth = src.depth() == LCV_32F || src.depth() == LCV_64F ? LCV_64F : LCV_32F;
+        box_filter(src, dst, ddepth, ksize, offset, normalize, true, borderType);
+    } // sqrBoxFilter
+
+    void GaussianBlur(const Matrix& src, Matrix& dst, Size ksize, double sigmaX, double sigmaY = 0, int borderType = BORDER_DEFAULT)
+    {
+        // Separable Gaussian of `ksize`, zero sizes are computed from sigmas, non-positive `sigmaY` is `sigmaX`
+        // Kernels are Q8 fixed-point and filtering is in integers, so results do not depend on threads or CPU
+        if (sigmaY <= 0)
+            sigmaY = sigmaX;
+        if (ksize.width <= 0 && sigmaX > 0)
+            ksize.width = lcvRound(sigmaX * 3 * 2 + 1) | 1;
+        if (ksize.height <= 0 && sigmaY > 0)
+            ksize.height = lcvRound(sigmaY * 3 * 2 + 1) | 1;
+        assert(ksize.width > 0 && ksize.width % 2 == 1 && ksize.height > 0 && ksize.height % 2 == 1);
+
+        gaussian_blur(src, dst, gaussian_fixed_kernel(ksize.width, sigmaX), gaussian_fixed_kernel(ksize.height, sigmaY), borderType);
+    } // GaussianBlur
+} // namespace lcv
 #endif // LCV_IMGPROC_FILTER_HPP
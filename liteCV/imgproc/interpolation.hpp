@@ -4,6 +4,9 @@
 #include "liteCV/core/lcvdef.hpp"
 #include "liteCV/core/lcvmath.hpp"
 #include "liteCV/core/matrix.hpp"
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
 
 
 namespace lcv
@@ -14,32 +17,31 @@ namespace lcv
         INTER_LINEAR = 1
     }; // enum InterpolationFlags
 
-    class InterpolationPolicy
+    /* ///////////////////////////////////////
+    *  //    Interpolation policies
+    */ //
+    // `interpolate(src, dwidth, dheight, dx, dy, ch)` samples channel `ch` of `src` at the point mapped backward
+    // from `(dx, dy)` of a `dwidth x dheight` image
+    // Policies are template parameters of resampling kernels, see `with_interpolation_policy`
+    struct NearestInterpolationPolicy
     {
-    public:
-        virtual double interpolate(const Matrix& src, int dwidth, int dheight, int dx, int dy, int ch) = 0;
-    }; // class InterpolationPolicy
-
-    class NearestInterpolationPolicy : public InterpolationPolicy
-    {
-    public:
-        double interpolate(const Matrix& src, int dwidth, int dheight, int dx, int dy, int ch) final
+        static double interpolate(const Matrix& src, int dwidth, int dheight, int dx, int dy, int ch)
         {
-            const int sx = lcvRound(((float)dx / dwidth) * src.cols);
-            const int sy = lcvRound(((float)dy / dheight) * src.rows);
+            // Points mapped near the right and bottom sides can round to one past the last pixel
+            const int sx = std::min(lcvRound(((float)dx / dwidth) * src.cols), src.cols - 1);
+            const int sy = std::min(lcvRound(((float)dy / dheight) * src.rows), src.rows - 1);
             return (double)src.ptr<uchar>(sy, sx)[ch];
         }
-    }; // class NearestInterpolationPolicy
+    }; // struct NearestInterpolationPolicy
 
-    class LinearInterpolationPolicy : public InterpolationPolicy
+    struct LinearInterpolationPolicy
     {
-        double inline calc_ratio(double p)
+        static double calc_ratio(double p)
         {
             return p - (int)p;
         }
 
-    public:
-        double interpolate(const Matrix& src, int dwidth, int dheight, int dx, int dy, int ch) final
+        static double interpolate(const Matrix& src, int dwidth, int dheight, int dx, int dy, int ch)
         {
             // p is a point on src and can be mapped bacward from dst
             // a, b, c, d are neighbors of p
@@ -55,10 +57,13 @@ namespace lcv
             const double sx = ((double)dx / dwidth) * src.cols;
             const double sy = ((double)dy / dheight) * src.rows;
 
-            const double a = (double)src.ptr<uchar>(lcvFloor(sy), lcvFloor(sx))[ch];
-            const double b = (double)src.ptr<uchar>(lcvFloor(sy), lcvCeil(sx))[ch];
-            const double c = (double)src.ptr<uchar>(lcvCeil(sy), lcvFloor(sx))[ch];
-            const double d = (double)src.ptr<uchar>(lcvCeil(sy), lcvCeil(sx))[ch];
+            // Neighbors past the right and bottom sides are the last pixels
+            const int x0 = lcvFloor(sx), x1 = std::min(lcvCeil(sx), src.cols - 1);
+            const int y0 = lcvFloor(sy), y1 = std::min(lcvCeil(sy), src.rows - 1);
+            const double a = (double)src.ptr<uchar>(y0, x0)[ch];
+            const double b = (double)src.ptr<uchar>(y0, x1)[ch];
+            const double c = (double)src.ptr<uchar>(y1, x0)[ch];
+            const double d = (double)src.ptr<uchar>(y1, x1)[ch];
 
             const double alpha = calc_ratio(sx);
             const double beta = calc_ratio(sy);
@@ -68,30 +73,24 @@ namespace lcv
 
             return e + (beta * (f - e));
         }
-    }; // class LinearInterpolationPolicy
+    }; // struct LinearInterpolationPolicy
 
-    class InterpolationPolicyStorage
+    template<template<typename> class Op, typename... Args>
+    void with_interpolation_policy(int interpolation, Args&&... args)
     {
-    private:
-        InterpolationPolicyStorage() = delete;
-
-    public:
-        static InterpolationPolicy* get_policy(int flag = INTER_NEAREST)
+        // Run `Op<Policy>::run(args...)` with the policy of `interpolation` chosen once per call
+        switch (interpolation)
         {
-            static NearestInterpolationPolicy nip;
-            static LinearInterpolationPolicy lip;
+        case INTER_NEAREST:
+            Op<NearestInterpolationPolicy>::run(std::forward<Args>(args)...);
+            return;
 
-            switch (flag)
-            {
-            case INTER_NEAREST:
-                return static_cast<InterpolationPolicy*>(&nip);
-
-            case INTER_LINEAR:
-                return static_cast<InterpolationPolicy*>(&lip);
-            }
-
-            return nullptr;
+        case INTER_LINEAR:
+            Op<LinearInterpolationPolicy>::run(std::forward<Args>(args)...);
+            return;
         }
-    }; // class InterpolationPolicyStorage
+
+        throw std::invalid_argument("Unsupported interpolation");
+    } // with_interpolation_policy
 } // namespace lcv
 #endif // LCV_IMGPROC_INTERPOLATION_HPP
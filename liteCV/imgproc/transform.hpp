@@ -1,23 +1,51 @@
 #pragma once
 #ifndef LCV_IMGPROC_TRANSFORM_HPP
+#define LCV_IMGPROC_TRANSFORM_HPP
 #include "liteCV/core/lcvdef.hpp"
 #include "liteCV/core/lcvmath.hpp"
 #include "liteCV/core/lcvtypes.hpp"
 #include "liteCV/core/saturate.hpp"
 #include "liteCV/core/matrix.hpp"
+#include "liteCV/core/parallel.hpp"
 
 #include "interpolation.hpp"
 
 
 namespace lcv
 {
+    template<typename Policy>
+    struct ResizeEngine
+    {
+        // Each pixel of `output` samples `src` by `Policy`, which is inlined instead of called per pixel
+        // Not compiled per CPU level, sampling gathers scalars and copies of wider levels do not vectorize it
+        static void run(const Matrix& src, Matrix& output)
+        {
+            const int channels = output.channels();
+            parallel_for_(Range(0, output.rows), [&](const Range& range)
+            {
+                for (int y = range.start; y < range.end; ++y)
+                {
+                    uchar* scanline = output.ptr<uchar>(y);
+
+                    // Loop width
+                    for (int x = 0; x < output.cols; ++x)
+                    {
+                        // Loop channel
+                        for (int ch = 0; ch < channels; ++ch)
+                            scanline[x * channels + ch] = saturate_cast<uchar>(Policy::interpolate(src, output.cols, output.rows, x, y, ch));
+                    } // Width
+                } // Height
+            }, parallel_grain((int64)output.cols * channels));
+        }
+    }; // struct ResizeEngine
+
     void resize(const Matrix& src, Matrix& dst, Size dsize, double fx = 0, double fy = 0, int interpolation = INTER_LINEAR)
     {
         // Only support 8-bits depth image
-        assert(src.depth() == LCV_8U);
+        assert(src.depth() == LCV_8U && !src.isPlanar());
 
         // both dsize and fx|fy cannot be zero
-        assert(dsize.area() == 0 && (fx == 0 || fy == 0));
+        assert(dsize.area() != 0 || (fx > 0 && fy > 0));
 
         const int width = src.cols;
         const int height = src.rows;
@@ -27,27 +55,9 @@ namespace lcv
         // scaled width and scaled height must not be zero
         assert(scaled_width * scaled_height != 0);
 
-        Matrix output(scaled_width, scaled_height, src.type());
-
-        // Loop height
-        LCV_OMP_LOOP_FOR
-        for (int y = 0; y < output.rows; ++y)
-        {
-            // Loop width
-            for (int x = 0; x < output.cols; ++x)
-            {
-                const int forward_x = lcvRound(((float)x / scaled_width) * width);
-
-                // Loop channel
-                for (int ch = 0; ch < output.channels(); ++ch)
-                {
-                    InterpolationPolicy* ip = InterpolationPolicyStorage::get_policy(interpolation);
-                    output.ptr<uchar>(y, x)[ch] = saturate_cast<uchar>(ip->interpolate(src, scaled_width, scaled_height, x, y, ch));
-                } // Channel
-            } // Width
-        } // Height
-
-        dst = output;
+        Matrix output = reuse_or_create(dst, src, scaled_width, scaled_height, src.type());
+        with_interpolation_policy<ResizeEngine>(interpolation, src, output);
+        dst = std::move(output);
     } // resize
 } // namespace lcv
 #endif // LCV_IMGPROC_TRANSFORM_HPP